@@ -0,0 +1,428 @@
+#include "archivo_huf.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include "archivo_mapeado.h"
+#include "huffman.h"
+#include "perfil.h"
+
+namespace {
+
+const unsigned char kMagic[4] = { 'H', 'U', 'F', 'C' };
+const unsigned kVersion = 2;
+const unsigned kVersionPredicted = 3;    // Versión 2 más el predictor en el campo reservado
+const unsigned kModelFrequencies = 0;    // M + 1 frecuencias u32
+const unsigned kModelCodeLengths = 1;    // Longitudes del código canónico
+const unsigned kModelShared = 2;         // Modelo fuera del flujo (por ejemplo en un .hufv)
+const int kMaxCodeLength = 15;           // Entra en medio byte
+const size_t kFixedHeader = 32;            // Hasta bytesModelo inclusive
+const size_t kIndexEntry = 16;             // desplazamiento + tamaño + crc
+const size_t kTargetBlockPixels = 65536;   // Píxeles aproximados por bloque
+
+uint32_t blockRowsFor(uint32_t width) {
+    return std::max<uint32_t>(1, kTargetBlockPixels / std::max<uint32_t>(1, width));
+}
+
+struct CrcTable {
+    uint32_t entries[256];
+    CrcTable() {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[n] = c;
+        }
+    }
+};
+
+// Copia las filas [rowBegin, rowEnd) de src en un buffer nuevo.
+void cropRows(const PixelBuffer& src, int rowBegin, int rowEnd, PixelBuffer& dst) {
+    PixelBuffer rows;
+    rows.allocate(src.width(), rowEnd - rowBegin, 1, src.maxValue());
+    const size_t bpp = src.bytesPerPixel();
+    for (int i = rowBegin; i < rowEnd; ++i)
+        std::memcpy(rows.data() + (i - rowBegin) * rows.rowStride() * bpp,
+                    src.data() + i * src.rowStride() * bpp, src.width() * bpp);
+    std::swap(dst, rows);
+}
+
+// ————————————
+// Formato anterior: ancho(u16) alto(u16) M(u8), M + 1 frecuencias
+// unsigned long y un único flujo de bits. Se decodifica completo y de
+// forma tolerante (un flujo truncado deja en cero los píxeles faltantes).
+//————————————
+HufStatus readLegacy(const unsigned char* bytes, size_t size, PixelBuffer& image,
+                     int rowBegin, int rowEnd) {
+    if (size < 5) return HufStatus::Corrupt;
+    uint16_t w, h;
+    std::memcpy(&w, bytes, sizeof(w));
+    std::memcpy(&h, bytes + 2, sizeof(h));
+    int maxVal = bytes[4];
+
+    size_t offset = 5 + (maxVal + 1) * sizeof(unsigned long);
+    if (size < offset) return HufStatus::Corrupt;
+    if (rowEnd < 0) rowEnd = h;
+    if (rowBegin < 0 || rowBegin >= rowEnd || rowEnd > h) return HufStatus::BadRange;
+
+    std::vector<unsigned long> freq(maxVal + 1);
+    std::memcpy(freq.data(), bytes + 5, (maxVal + 1) * sizeof(unsigned long));
+
+    PixelBuffer img;
+    img.allocate(w, h, 1, maxVal);
+    HuffmanTree tree;
+    buildHuffmanTree(freq, tree);
+    HuffmanDecoder decoder(tree);
+    decoder.decode(bytes + offset, size - offset, img, 0, rowEnd);   // El flujo empieza en la fila 0
+
+    if (rowBegin == 0 && rowEnd == h) std::swap(image, img);
+    else cropRows(img, rowBegin, rowEnd, image);
+    return HufStatus::Ok;
+}
+
+struct BlockEntry {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t crc;
+};
+
+// Reconstruye el árbol del modelo guardado en la cabecera; con el modelo
+// externo (kModelShared) usa las longitudes de shared.
+bool parseModel(unsigned kind, const unsigned char* model, uint32_t modelSize, uint32_t maxValue,
+                const std::vector<uint8_t>* shared, HuffmanTree& tree) {
+    const uint32_t symbols = maxValue + 1;
+    if (kind == kModelFrequencies) {
+        if (modelSize != symbols * 4) return false;
+        std::vector<unsigned long> freq(symbols);
+        for (uint32_t s = 0; s < symbols; ++s) freq[s] = get32(model + 4 * s);
+        buildHuffmanTree(freq, tree);
+        return true;
+    }
+    if (kind == kModelShared) {
+        if (modelSize != 0 || !shared || shared->size() != symbols) return false;
+        return buildCanonicalTree(*shared, tree);
+    }
+    std::vector<uint8_t> lengths;
+    return kind == kModelCodeLengths && parseHufModel(model, modelSize, maxValue, lengths) &&
+           buildCanonicalTree(lengths, tree);
+}
+
+HufStatus readChunked(const unsigned char* bytes, size_t size, PixelBuffer& image, ThreadPool& pool,
+                      int rowBegin, int rowEnd, const std::vector<uint8_t>* shared) {
+    // 1. Cabecera fija
+    if (size < kFixedHeader + 4 || (bytes[4] != kVersion && bytes[4] != kVersionPredicted))
+        return HufStatus::Corrupt;
+    Predictor predictor = Predictor::None;
+    if (bytes[4] == kVersionPredicted) {
+        const unsigned id = bytes[6] | (bytes[7] << 8);
+        if (id < static_cast<unsigned>(Predictor::Left) || id > static_cast<unsigned>(Predictor::Med))
+            return HufStatus::Corrupt;
+        predictor = static_cast<Predictor>(id);
+    }
+    const uint32_t width = get32(bytes + 8), height = get32(bytes + 12);
+    const uint32_t maxValue = get32(bytes + 16), blockRows = get32(bytes + 20);
+    const uint32_t blockCount = get32(bytes + 24), modelSize = get32(bytes + 28);
+    if (width == 0 || height == 0 || width > 0x7fffffff || height > 0x7fffffff ||
+        maxValue > 65535 || blockRows == 0 ||
+        blockCount != (height + blockRows - 1) / blockRows || modelSize > size)
+        return HufStatus::Corrupt;
+
+    // 2. Modelo, índice y CRC de la cabecera
+    const size_t headerSize = kFixedHeader + modelSize + blockCount * kIndexEntry + 4;
+    if (size < headerSize) return HufStatus::Corrupt;
+    if (computeCrc32(bytes, headerSize - 4) != get32(bytes + headerSize - 4))
+        return HufStatus::Corrupt;
+
+    const unsigned char* model = bytes + kFixedHeader;
+    HuffmanTree tree;
+    if (!parseModel(bytes[5], model, modelSize, maxValue, shared, tree)) return HufStatus::Corrupt;
+
+    // Lo que pide la cabecera tiene que entrar en los bloques antes de
+    // reservarlo: cada píxel ocupa al menos un bit, salvo con un árbol de un
+    // solo símbolo (modelo de frecuencias de una imagen constante), cuyos
+    // bloques quedan vacíos y solo pueden tener las filas que usa el codificador
+    const uint64_t bytesPerPixel = maxValue > 255 ? 2 : 1;
+    if (uint64_t(width) * height > std::numeric_limits<size_t>::max() / bytesPerPixel)
+        return HufStatus::Corrupt;
+    const bool constant = tree.root >= 0 && tree.nodes[tree.root].symbol >= 0;
+    if (constant && blockRows != blockRowsFor(width)) return HufStatus::Corrupt;
+
+    const unsigned char* payload = bytes + headerSize;
+    const size_t payloadSize = size - headerSize;
+    std::vector<BlockEntry> blocks(blockCount);
+    const unsigned char* index = model + modelSize;
+    for (uint32_t b = 0; b < blockCount; ++b) {
+        blocks[b].offset = get64(index + b * kIndexEntry);
+        blocks[b].size = get32(index + b * kIndexEntry + 8);
+        blocks[b].crc = get32(index + b * kIndexEntry + 12);
+        if (blocks[b].offset > payloadSize || blocks[b].size > payloadSize - blocks[b].offset)
+            return HufStatus::Corrupt;
+        const uint64_t rows = std::min<uint64_t>(height, (b + 1) * uint64_t(blockRows)) - b * uint64_t(blockRows);
+        if (!constant && rows * width > uint64_t(blocks[b].size) * 8) return HufStatus::Corrupt;
+    }
+
+    // 3. Bloques que cubren el rango pedido
+    if (rowEnd < 0) rowEnd = static_cast<int>(height);
+    if (rowBegin < 0 || rowBegin >= rowEnd || static_cast<uint32_t>(rowEnd) > height)
+        return HufStatus::BadRange;
+    const uint32_t firstBlock = rowBegin / blockRows;
+    const uint32_t lastBlock = (rowEnd - 1) / blockRows;
+    const int coverBegin = static_cast<int>(firstBlock * blockRows);
+    const int coverEnd = static_cast<int>(std::min(height, (lastBlock + 1) * blockRows));
+
+    PixelBuffer cover;
+    cover.allocate(width, coverEnd - coverBegin, 1, maxValue);
+    HuffmanDecoder decoder(tree);
+
+    // 4. Verificar y decodificar los bloques en paralelo, cada uno en sus filas
+    std::vector<unsigned char> ok(blockCount, 1);
+    pool.parallelFor(firstBlock, lastBlock + 1, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            const unsigned char* data = payload + blocks[b].offset;
+            if (computeCrc32(data, blocks[b].size) != blocks[b].crc) {
+                ok[b] = 0;
+                continue;
+            }
+            int r0 = static_cast<int>(b * blockRows);
+            int r1 = static_cast<int>(std::min<uint64_t>(height, (b + 1) * uint64_t(blockRows)));
+            size_t decoded = decoder.decode(data, blocks[b].size, cover,
+                                            r0 - coverBegin, r1 - coverBegin, predictor);
+            if (decoded != static_cast<size_t>(r1 - r0) * width) ok[b] = 0;
+        }
+    });
+    for (uint32_t b = firstBlock; b <= lastBlock; ++b)
+        if (!ok[b]) return HufStatus::Corrupt;
+
+    if (rowBegin == coverBegin && rowEnd == coverEnd) std::swap(image, cover);
+    else cropRows(cover, rowBegin - coverBegin, rowEnd - coverBegin, image);
+    return HufStatus::Ok;
+}
+
+// Frecuencias de los símbolos a codificar (niveles de gris o residuos) con
+// cada predictor de candidates; la predicción vuelve a empezar en cada
+// bloque de blockRows filas, igual que al codificar.
+template <typename T>
+void countRows(const PixelBuffer& image, int rowBegin, int rowEnd, uint32_t blockRows,
+               const std::vector<Predictor>& candidates,
+               std::vector<std::vector<unsigned long> >& freq) {
+    const int width = image.width();
+    std::vector<T> residuals(width);
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        const T* row = image.row<T>(0, i);
+        const T* above = i % blockRows ? image.row<T>(0, i - 1) : nullptr;
+        for (size_t p = 0; p < candidates.size(); ++p) {
+            const T* symbols = row;
+            if (candidates[p] != Predictor::None) {
+                predictRow(candidates[p], row, above, width, image.maxValue(), residuals.data());
+                symbols = residuals.data();
+            }
+            unsigned long* counts = freq[p].data();
+            for (int j = 0; j < width; ++j) counts[symbols[j]]++;
+        }
+    }
+}
+
+// Codifica image con el modelo ya elegido y deja el flujo completo en out.
+// Con embedModel = false el modelo queda fuera del flujo (kModelShared).
+void packHuf(const PixelBuffer& image, const HufModel& model, bool embedModel, ThreadPool& pool,
+             std::vector<unsigned char>& out) {
+    const uint32_t width = image.width(), height = image.height();
+    std::vector<HuffmanCode> codes;
+    buildCanonicalCodes(model.lengths, codes);
+
+    // 1. Codificar cada bloque de filas por separado, en paralelo
+    PhaseTimer packingTimer(Phase::BitPacking);
+    const uint32_t blockRows = blockRowsFor(width);
+    const uint32_t blockCount = (height + blockRows - 1) / blockRows;
+    std::vector<std::vector<unsigned char> > blocks(blockCount);
+    std::vector<uint32_t> crcs(blockCount);
+    pool.parallelFor(0, blockCount, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            int r0 = static_cast<int>(b * blockRows);
+            int r1 = static_cast<int>(std::min<uint64_t>(height, (b + 1) * uint64_t(blockRows)));
+            blocks[b].reserve(static_cast<size_t>(r1 - r0) * width);
+            encodePixels(image, codes, blocks[b], r0, r1, model.predictor);
+            crcs[b] = computeCrc32(blocks[b].data(), blocks[b].size());
+        }
+    });
+
+    // 2. Cabecera, modelo e índice de bloques, seguidos de los bloques
+    const Predictor predictor = model.predictor;
+    out.assign(kMagic, kMagic + 4);
+    out.push_back(static_cast<unsigned char>(predictor == Predictor::None ? kVersion : kVersionPredicted));
+    out.push_back(static_cast<unsigned char>(embedModel ? kModelCodeLengths : kModelShared));
+    put16(out, static_cast<uint32_t>(predictor));
+    put32(out, width);
+    put32(out, height);
+    put32(out, image.maxValue());
+    put32(out, blockRows);
+    put32(out, blockCount);
+    std::vector<unsigned char> lengths;
+    if (embedModel) putHufModel(lengths, model.lengths);
+    put32(out, static_cast<uint32_t>(lengths.size()));
+    out.insert(out.end(), lengths.begin(), lengths.end());
+    uint64_t offset = 0;
+    for (uint32_t b = 0; b < blockCount; ++b) {
+        put64(out, offset);
+        put32(out, static_cast<uint32_t>(blocks[b].size()));
+        put32(out, crcs[b]);
+        offset += blocks[b].size();
+    }
+    put32(out, computeCrc32(out.data(), out.size()));
+    out.reserve(out.size() + offset);
+    for (uint32_t b = 0; b < blockCount; ++b) out.insert(out.end(), blocks[b].begin(), blocks[b].end());
+}
+
+}  // namespace
+
+uint32_t computeCrc32(const void* data, size_t size, uint32_t crc) {
+    static const CrcTable table;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) crc = table.entries[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+bool parseHufModel(const unsigned char* model, uint32_t modelSize, uint32_t maxValue,
+                   std::vector<uint8_t>& lengths) {
+    // Bits por longitud (4 u 8) y luego las longitudes, de a dos por byte si entran
+    const uint32_t symbols = maxValue + 1;
+    if (modelSize == 0) return false;
+    const unsigned bits = model[0];
+    if ((bits != 4 && bits != 8) || modelSize != 1 + (bits == 4 ? (symbols + 1) / 2 : symbols))
+        return false;
+    lengths.resize(symbols);
+    for (uint32_t s = 0; s < symbols; ++s)
+        lengths[s] = bits == 8 ? model[1 + s] : (model[1 + s / 2] >> (s % 2 ? 0 : 4)) & 0x0f;
+    return true;
+}
+
+void putHufModel(std::vector<unsigned char>& out, const std::vector<uint8_t>& lengths) {
+    // Medio byte por símbolo si todas las longitudes caben
+    const bool packed = *std::max_element(lengths.begin(), lengths.end()) <= 15;
+    out.push_back(packed ? 4 : 8);
+    if (!packed) {
+        out.insert(out.end(), lengths.begin(), lengths.end());
+        return;
+    }
+    for (size_t s = 0; s < lengths.size(); s += 2)
+        out.push_back(static_cast<unsigned char>(lengths[s] << 4 | (s + 1 < lengths.size() ? lengths[s + 1] : 0)));
+}
+
+std::vector<Predictor> predictorCandidates(Predictor predictor) {
+    std::vector<Predictor> candidates(1, predictor);
+    if (predictor == Predictor::Auto) {
+        candidates.clear();
+        for (int p = 0; p < static_cast<int>(Predictor::Auto); ++p) candidates.push_back(static_cast<Predictor>(p));
+    }
+    return candidates;
+}
+
+void countHufSymbols(const PixelBuffer& image, const std::vector<Predictor>& candidates, ThreadPool& pool,
+                     std::vector<std::vector<unsigned long> >& freq) {
+    PhaseTimer timer(Phase::HuffmanModel);
+    const size_t bins = image.maxValue() + 1;
+    const uint32_t blockRows = blockRowsFor(image.width());
+    freq.resize(candidates.size());
+    for (size_t p = 0; p < candidates.size(); ++p) freq[p].resize(bins, 0);
+    std::mutex merge;
+    pool.parallelFor(0, image.height(), pool.grainFor(image.height()), [&](size_t begin, size_t end) {
+        std::vector<std::vector<unsigned long> > local(candidates.size(), std::vector<unsigned long>(bins, 0));
+        const int r0 = static_cast<int>(begin), r1 = static_cast<int>(end);
+        if (image.wide()) countRows<uint16_t>(image, r0, r1, blockRows, candidates, local);
+        else countRows<uint8_t>(image, r0, r1, blockRows, candidates, local);
+        std::lock_guard<std::mutex> lock(merge);
+        for (size_t p = 0; p < candidates.size(); ++p)
+            for (size_t s = 0; s < bins; ++s) freq[p][s] += local[p][s];
+    });
+}
+
+HufModel chooseHufModel(const std::vector<Predictor>& candidates,
+                        const std::vector<std::vector<unsigned long> >& freq) {
+    PhaseTimer timer(Phase::HuffmanModel);
+    HufModel best;
+    uint64_t bestBits = 0;
+    for (size_t p = 0; p < candidates.size(); ++p) {
+        size_t symbols = 0;
+        for (size_t s = 0; s < freq[p].size(); ++s) symbols += freq[p][s] > 0;
+        int maxLength = kMaxCodeLength;
+        while ((size_t(1) << maxLength) < symbols) ++maxLength;     // Solo con más de 2^15 niveles
+        std::vector<uint8_t> lengths;
+        buildCodeLengths(freq[p], maxLength, lengths);
+        uint64_t bits = 0;
+        for (size_t s = 0; s < freq[p].size(); ++s) bits += static_cast<uint64_t>(freq[p][s]) * lengths[s];
+        if (p == 0 || bits < bestBits) {
+            bestBits = bits;
+            best.predictor = candidates[p];
+            best.lengths.swap(lengths);
+        }
+    }
+    return best;
+}
+
+HufStatus encodeHuf(const PixelBuffer& image, ThreadPool& pool, Predictor predictor,
+                    std::vector<unsigned char>& out, Predictor* used) {
+    if (static_cast<uint64_t>(image.width()) * image.height() > 0xffffffffu) return HufStatus::WriteError;
+
+    // Modelo: frecuencias y códigos compartidos por todos los bloques. Con
+    // Auto se cuentan los residuos de todos los predictores en la misma
+    // pasada y se elige el que da el menor tamaño codificado
+    const std::vector<Predictor> candidates = predictorCandidates(predictor);
+    std::vector<std::vector<unsigned long> > freq;
+    countHufSymbols(image, candidates, pool, freq);
+    const HufModel model = chooseHufModel(candidates, freq);
+    if (used) *used = model.predictor;
+    packHuf(image, model, true, pool, out);
+    return HufStatus::Ok;
+}
+
+HufStatus encodeHufShared(const PixelBuffer& image, const HufModel& model, ThreadPool& pool,
+                          std::vector<unsigned char>& out) {
+    if (static_cast<uint64_t>(image.width()) * image.height() > 0xffffffffu) return HufStatus::WriteError;
+    packHuf(image, model, false, pool, out);
+    return HufStatus::Ok;
+}
+
+HufStatus writeHufFile(const std::string& filename, const PixelBuffer& image, ThreadPool& pool,
+                       Predictor predictor, size_t* bytesWritten, Predictor* used) {
+    std::vector<unsigned char> data;
+    HufStatus status = encodeHuf(image, pool, predictor, data, used);
+    if (status != HufStatus::Ok) return status;
+
+    // Escribir en un temporal y renombrar, como los PGM
+    PhaseTimer writeTimer(Phase::FileWrite);
+    const std::string tmpName = temporaryName(filename);
+    std::ofstream file(tmpName, std::ios::binary);
+    if (!file) return HufStatus::WriteError;
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    file.close();
+    if (!file || std::rename(tmpName.c_str(), filename.c_str()) != 0) {
+        std::remove(tmpName.c_str());
+        return HufStatus::WriteError;
+    }
+    recordBytesWritten(data.size());
+    if (bytesWritten) *bytesWritten = data.size();
+    return HufStatus::Ok;
+}
+
+HufStatus decodeHuf(const unsigned char* bytes, size_t size, PixelBuffer& image, ThreadPool& pool,
+                    int rowBegin, int rowEnd, const std::vector<uint8_t>* sharedLengths) {
+    PhaseTimer timer(Phase::HuffmanDecode);
+    if (size < 4 || std::memcmp(bytes, kMagic, 4) != 0) return HufStatus::Corrupt;
+    return readChunked(bytes, size, image, pool, rowBegin, rowEnd, sharedLengths);
+}
+
+HufStatus readHufFile(const std::string& filename, PixelBuffer& image, ThreadPool& pool,
+                      int rowBegin, int rowEnd) {
+    MappedFile in;
+    if (!in.open(filename)) return HufStatus::OpenError;
+    recordBytesRead(in.size());
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(in.data());
+
+    if (in.size() >= 4 && std::memcmp(bytes, kMagic, 4) == 0)
+        return decodeHuf(bytes, in.size(), image, pool, rowBegin, rowEnd);
+    PhaseTimer timer(Phase::HuffmanDecode);
+    return readLegacy(bytes, in.size(), image, rowBegin, rowEnd);
+}
@@ -0,0 +1,127 @@
+#ifndef ARCHIVO_HUF_H
+#define ARCHIVO_HUF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "huffman.h"
+#include "imagen.h"
+#include "pool_hilos.h"
+
+// ————————————
+// Contenedor .huf por bloques (versiones 2 y 3).
+//
+// La imagen se divide en bloques de filas que se codifican por separado con
+// un mismo modelo de Huffman. La cabecera lleva un número mágico, la versión,
+// el modelo y un índice con la posición, el tamaño y el CRC-32 de cada
+// bloque, más un CRC-32 de la propia cabecera. Así los bloques se codifican
+// y decodifican en paralelo, y se puede decodificar solo un rango de filas.
+//
+// Todos los enteros se guardan en little-endian:
+//
+//   "HUFC"  versión(u8)=2|3  modelo(u8)  predictor(u16)
+//   ancho(u32)  alto(u32)  M(u32)  filasPorBloque(u32)  bloques(u32)
+//   bytesModelo(u32)  modelo[bytesModelo]
+//   índice: bloques x { desplazamiento(u64)  tamaño(u32)  crc(u32) }
+//   crcCabecera(u32)
+//   datos de los bloques (cada uno completa su último byte con ceros)
+//
+// Modelo 1 (el que se escribe): código de Huffman canónico, guardado solo
+// como la longitud del código de cada símbolo (0 = no aparece), de a lo sumo
+// 15 bits: un byte con los bits por longitud (4 u 8) y luego las M + 1
+// longitudes, dos por byte cuando caben en 4 bits.
+// Modelo 0: M + 1 frecuencias de 32 bits.
+//
+// Modelo 2: el modelo está fuera del flujo (0 bytes) y quien decodifica lo
+// recibe aparte; lo usan los cortes de un .hufv con modelo compartido.
+//
+// Versión 3: los símbolos son residuos de predicción (ver Predictor en
+// huffman.h) y predictor indica cuál: 1 izquierda, 2 arriba, 3 promedio,
+// 4 MED. La predicción vuelve a empezar en la primera fila de cada bloque.
+// Sin predicción se escribe la versión 2, con ese campo en 0.
+//
+// Los archivos del formato anterior (ancho y alto u16, M u8, frecuencias
+// unsigned long y un solo flujo de bits) se siguen pudiendo leer.
+//————————————
+enum class HufStatus {
+    Ok,
+    OpenError,      // No se pudo abrir el archivo
+    Corrupt,        // Cabecera inválida, datos truncados o CRC incorrecto
+    BadRange,       // El rango de filas pedido no está dentro de la imagen
+    WriteError      // No se pudo escribir el archivo de salida
+};
+
+// CRC-32 (polinomio 0xEDB88320) de size bytes, continuando desde crc.
+uint32_t computeCrc32(const void* data, size_t size, uint32_t crc = 0);
+
+// Enteros little-endian de las cabeceras (.huf, .hufv y .vcache).
+inline void put16(std::vector<unsigned char>& out, uint32_t v) {
+    out.push_back(static_cast<unsigned char>(v));
+    out.push_back(static_cast<unsigned char>(v >> 8));
+}
+inline void put32(std::vector<unsigned char>& out, uint32_t v) {
+    put16(out, v & 0xffff);
+    put16(out, v >> 16);
+}
+inline void put64(std::vector<unsigned char>& out, uint64_t v) {
+    put32(out, static_cast<uint32_t>(v));
+    put32(out, static_cast<uint32_t>(v >> 32));
+}
+inline uint32_t get32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+inline uint64_t get64(const unsigned char* p) {
+    return get32(p) | (static_cast<uint64_t>(get32(p + 4)) << 32);
+}
+
+// Modelo de un flujo: predictor y longitud del código canónico de cada símbolo.
+struct HufModel {
+    Predictor predictor;
+    std::vector<uint8_t> lengths;
+};
+
+// Longitudes guardadas como en el modelo 1 (ver arriba).
+bool parseHufModel(const unsigned char* model, uint32_t modelSize, uint32_t maxValue,
+                   std::vector<uint8_t>& lengths);
+void putHufModel(std::vector<unsigned char>& out, const std::vector<uint8_t>& lengths);
+
+// Auto da todos los predictores; cualquier otro, solo él.
+std::vector<Predictor> predictorCandidates(Predictor predictor);
+
+// Suma a freq[p] los símbolos que codificaría image con candidates[p], en
+// una sola pasada; freq se agranda si hace falta. Con varias imágenes del
+// mismo tamaño se acumula el modelo compartido.
+void countHufSymbols(const PixelBuffer& image, const std::vector<Predictor>& candidates, ThreadPool& pool,
+                     std::vector<std::vector<unsigned long> >& freq);
+
+// El candidato de menor tamaño codificado, con sus longitudes de código.
+HufModel chooseHufModel(const std::vector<Predictor>& candidates,
+                        const std::vector<std::vector<unsigned long> >& freq);
+
+// Codifica image en out (un .huf completo, con su modelo). used recibe el
+// predictor aplicado (el elegido, si se pidió Auto).
+HufStatus encodeHuf(const PixelBuffer& image, ThreadPool& pool, Predictor predictor,
+                    std::vector<unsigned char>& out, Predictor* used = nullptr);
+
+// Igual, con un modelo elegido afuera que no se guarda en out (modelo 2).
+HufStatus encodeHufShared(const PixelBuffer& image, const HufModel& model, ThreadPool& pool,
+                          std::vector<unsigned char>& out);
+
+// Codifica image y la guarda en filename. bytesWritten recibe el tamaño
+// final y used el predictor aplicado.
+HufStatus writeHufFile(const std::string& filename, const PixelBuffer& image, ThreadPool& pool,
+                       Predictor predictor = Predictor::None, size_t* bytesWritten = nullptr,
+                       Predictor* used = nullptr);
+
+// Decodifica un .huf en memoria (no el formato anterior). Las filas son
+// como en readHufFile; sharedLengths es el modelo de un flujo con modelo 2.
+HufStatus decodeHuf(const unsigned char* bytes, size_t size, PixelBuffer& image, ThreadPool& pool,
+                    int rowBegin = 0, int rowEnd = -1, const std::vector<uint8_t>* sharedLengths = nullptr);
+
+// Decodifica filename en image. Con rowEnd >= 0 solo se decodifican los
+// bloques que cubren las filas [rowBegin, rowEnd), e image recibe solo esas filas.
+HufStatus readHufFile(const std::string& filename, PixelBuffer& image, ThreadPool& pool,
+                      int rowBegin = 0, int rowEnd = -1);
+
+#endif
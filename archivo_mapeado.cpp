@@ -0,0 +1,52 @@
+#include "archivo_mapeado.h"
+
+#include <atomic>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : data_(nullptr), size_(0) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void* p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            size_ = 0;
+            return false;
+        }
+        data_ = static_cast<char*>(p);
+        madvise(p, size_, MADV_SEQUENTIAL);   // Lectura lineal: pedir read-ahead agresivo
+    }
+
+    ::close(fd);  // La proyección sigue siendo válida sin el descriptor
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+std::string temporaryName(const std::string& filename) {
+    static std::atomic<unsigned long> counter(0);
+    return filename + ".tmp." + std::to_string(getpid()) + "." + std::to_string(counter++);
+}
@@ -0,0 +1,38 @@
+#ifndef ARCHIVO_MAPEADO_H
+#define ARCHIVO_MAPEADO_H
+
+#include <cstddef>
+#include <string>
+
+// ————————————
+// Archivo proyectado en memoria con mmap.
+// El contenido completo queda accesible como un arreglo de bytes sin copias.
+// La proyección es privada: escribir en ella no modifica el archivo, solo
+// copia las páginas afectadas.
+//————————————
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string& filename);  // false si no se pudo abrir o proyectar
+    void close();
+
+    char* data() { return data_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile(const MappedFile&);             // No copiable
+    MappedFile& operator=(const MappedFile&);
+
+    char* data_;
+    size_t size_;
+};
+
+// Nombre del temporal donde se escribe filename antes de renombrarlo. Es
+// distinto en cada llamada y en cada proceso, así que dos escrituras
+// simultáneas del mismo archivo no comparten temporal.
+std::string temporaryName(const std::string& filename);
+
+#endif
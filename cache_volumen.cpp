@@ -0,0 +1,124 @@
+#include "cache_volumen.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include "archivo_huf.h"
+#include "archivo_mapeado.h"
+#include "perfil.h"
+
+namespace {
+
+const unsigned char kMagic[4] = { 'V', 'C', 'A', 'C' };
+const unsigned kVersion = 1;
+const size_t kFixedHeader = 24;        // Hasta M inclusive
+const size_t kStampEntry = 20;         // tamaño + segundos + nanosegundos
+const size_t kDataAlignment = 4096;    // Los vóxeles empiezan en una página
+
+size_t dataOffset(size_t depth) {
+    size_t headerSize = kFixedHeader + depth * kStampEntry + 4;
+    return (headerSize + kDataAlignment - 1) / kDataAlignment * kDataAlignment;
+}
+
+}  // namespace
+
+bool stampSources(const std::vector<std::string>& files, std::vector<SourceStamp>& stamps) {
+    stamps.assign(files.size(), SourceStamp());
+    for (size_t k = 0; k < files.size(); ++k) {
+        struct stat st;
+        if (stat(files[k].c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+        stamps[k].size = static_cast<uint64_t>(st.st_size);
+        stamps[k].seconds = static_cast<uint64_t>(st.st_mtim.tv_sec);
+        stamps[k].nanoseconds = static_cast<uint32_t>(st.st_mtim.tv_nsec);
+    }
+    return true;
+}
+
+CacheStatus readVolumeCache(const std::string& filename, const std::vector<SourceStamp>& stamps,
+                            PixelBuffer& volume, size_t* bytesMapped) {
+    PhaseTimer timer(Phase::CacheLoad);
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(filename)) return CacheStatus::Missing;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file->data());
+    const size_t size = file->size();
+
+    if (size < kFixedHeader || std::memcmp(bytes, kMagic, 4) != 0 || bytes[4] != kVersion)
+        return CacheStatus::Corrupt;
+    const int bytesPerPixel = bytes[5];
+    const uint32_t width = get32(bytes + 8), height = get32(bytes + 12);
+    const uint32_t depth = get32(bytes + 16), maxValue = get32(bytes + 20);
+    if (depth != stamps.size()) return CacheStatus::Stale;
+
+    const size_t crcOffset = kFixedHeader + depth * kStampEntry;
+    if (size < crcOffset + 4 || get32(bytes + crcOffset) != computeCrc32(bytes, crcOffset))
+        return CacheStatus::Corrupt;
+    if (width == 0 || height == 0 || maxValue == 0 || maxValue > 65535 ||
+        bytesPerPixel != (maxValue > 255 ? 2 : 1))
+        return CacheStatus::Corrupt;
+
+    // Cada corte debe seguir teniendo el mismo tamaño y la misma fecha
+    for (uint32_t k = 0; k < depth; ++k) {
+        const unsigned char* entry = bytes + kFixedHeader + k * kStampEntry;
+        if (get64(entry) != stamps[k].size || get64(entry + 8) != stamps[k].seconds ||
+            get32(entry + 16) != stamps[k].nanoseconds)
+            return CacheStatus::Stale;
+    }
+
+    const size_t offset = dataOffset(depth);
+    const uint64_t voxels = static_cast<uint64_t>(width) * height * depth * bytesPerPixel;
+    if (size != offset + voxels) return CacheStatus::Corrupt;
+
+    unsigned char* pixels = reinterpret_cast<unsigned char*>(file->data()) + offset;
+    volume.wrap(width, height, depth, maxValue, width, pixels, file);
+    recordBytesRead(size);
+    if (bytesMapped) *bytesMapped = size;
+    return CacheStatus::Ok;
+}
+
+CacheStatus writeVolumeCache(const std::string& filename, const std::vector<SourceStamp>& stamps,
+                             const PixelBuffer& volume) {
+    if (static_cast<size_t>(volume.depth()) != stamps.size()) return CacheStatus::WriteError;
+
+    // 1. Cabecera con las marcas de los cortes, rellena hasta una página
+    std::vector<unsigned char> header(kMagic, kMagic + 4);
+    header.push_back(static_cast<unsigned char>(kVersion));
+    header.push_back(static_cast<unsigned char>(volume.bytesPerPixel()));
+    header.push_back(0);
+    header.push_back(0);
+    put32(header, volume.width());
+    put32(header, volume.height());
+    put32(header, volume.depth());
+    put32(header, volume.maxValue());
+    for (size_t k = 0; k < stamps.size(); ++k) {
+        put64(header, stamps[k].size);
+        put64(header, stamps[k].seconds);
+        put32(header, stamps[k].nanoseconds);
+    }
+    put32(header, computeCrc32(header.data(), header.size()));
+    header.resize(dataOffset(stamps.size()), 0);
+
+    // 2. Vóxeles fila por fila (el buffer puede tener filas más largas que el ancho)
+    PhaseTimer timer(Phase::FileWrite);
+    const std::string tmpName = temporaryName(filename);
+    std::ofstream file(tmpName, std::ios::binary);
+    if (!file) return CacheStatus::WriteError;
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    const size_t bpp = volume.bytesPerPixel();
+    const size_t rowBytes = volume.width() * bpp;
+    if (volume.rowStride() == static_cast<size_t>(volume.width())) {
+        file.write(reinterpret_cast<const char*>(volume.data()), volume.sizeInBytes());
+    } else {
+        for (int k = 0; k < volume.depth(); ++k)
+            for (int i = 0; i < volume.height(); ++i)
+                file.write(reinterpret_cast<const char*>(volume.data()) +
+                           (k * volume.sliceStride() + i * volume.rowStride()) * bpp, rowBytes);
+    }
+    file.close();
+    if (!file || std::rename(tmpName.c_str(), filename.c_str()) != 0) {
+        std::remove(tmpName.c_str());
+        return CacheStatus::WriteError;
+    }
+    recordBytesWritten(header.size() + rowBytes * volume.height() * volume.depth());
+    return CacheStatus::Ok;
+}
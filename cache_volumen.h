@@ -0,0 +1,54 @@
+#ifndef CACHE_VOLUMEN_H
+#define CACHE_VOLUMEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "imagen.h"
+
+// ————————————
+// Caché binaria de un volumen (<nombre_base>.vcache).
+//
+// Guarda el volumen ya decodificado y relleno al tamaño máximo, junto con
+// el tamaño y la fecha de modificación de cada corte PGM del que salió.
+// Mientras los cortes no cambien, una carga posterior proyecta el archivo
+// con mmap y envuelve los vóxeles sin leerlos ni copiarlos.
+//
+// Todos los enteros se guardan en little-endian:
+//
+//   "VCAC"  versión(u8)=1  bytesPorPíxel(u8)  reservado(u16)
+//   ancho(u32)  alto(u32)  cortes(u32)  M(u32)
+//   cortes x { tamaño(u64)  segundos(u64)  nanosegundos(u32) }
+//   crcCabecera(u32)
+//   relleno con ceros hasta un múltiplo de 4096
+//   vóxeles: corte por corte, fila por fila, sin relleno entre filas
+//————————————
+enum class CacheStatus {
+    Ok,
+    Missing,        // No existe la caché
+    Stale,          // Algún corte cambió, o la caché es de otra cantidad de cortes
+    Corrupt,        // Cabecera inválida o archivo truncado
+    WriteError      // No se pudo escribir la caché
+};
+
+// Tamaño y fecha de modificación de un archivo de origen.
+struct SourceStamp {
+    uint64_t size;
+    uint64_t seconds;
+    uint32_t nanoseconds;
+};
+
+// Toma la marca de cada archivo; false si alguno no existe.
+bool stampSources(const std::vector<std::string>& files, std::vector<SourceStamp>& stamps);
+
+// Proyecta filename en volume si sus marcas coinciden con stamps.
+// bytesMapped recibe el tamaño de la caché.
+CacheStatus readVolumeCache(const std::string& filename, const std::vector<SourceStamp>& stamps,
+                            PixelBuffer& volume, size_t* bytesMapped = nullptr);
+
+// Guarda volume en filename junto con las marcas de sus cortes.
+CacheStatus writeVolumeCache(const std::string& filename, const std::vector<SourceStamp>& stamps,
+                             const PixelBuffer& volume);
+
+#endif
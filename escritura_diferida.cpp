@@ -0,0 +1,99 @@
+#include "escritura_diferida.h"
+
+#include <cstdio>
+#include "archivo_mapeado.h"
+
+WriteBehind::WriteBehind(size_t maxPending)
+  : maxPending_(maxPending), pendingBytes_(0), writing_(false), writingProfile_(nullptr),
+    stopping_(false) {}
+
+WriteBehind::~WriteBehind() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void WriteBehind::submit(const std::string& filename, std::vector<char>& data) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!thread_.joinable()) thread_ = std::thread(&WriteBehind::writeLoop, this);   // Se crea al primer uso
+
+    // Un archivo más grande que el límite igual se acepta cuando no hay nada pendiente
+    changed_.wait(lock, [&] { return pendingBytes_ == 0 || pendingBytes_ + data.size() <= maxPending_; });
+    pendingBytes_ += data.size();
+    jobs_.push_back(Job());
+    jobs_.back().filename = filename;
+    jobs_.back().data.swap(data);
+    jobs_.back().profile = sessionProfile();
+    changed_.notify_all();
+}
+
+void WriteBehind::flush() {
+    ProfileCounters* profile = sessionProfile();
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [&] { return !pendingFor(profile); });
+}
+
+std::vector<std::string> WriteBehind::takeErrors() {
+    ProfileCounters* profile = sessionProfile();
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> errors;
+    size_t kept = 0;
+    for (size_t e = 0; e < errors_.size(); ++e) {
+        if (errors_[e].profile == profile) errors.push_back(errors_[e].filename);
+        else errors_[kept++] = errors_[e];
+    }
+    errors_.resize(kept);
+    return errors;
+}
+
+bool WriteBehind::pendingFor(ProfileCounters* profile) const {
+    if (writing_ && writingProfile_ == profile) return true;
+    for (size_t j = 0; j < jobs_.size(); ++j)
+        if (jobs_[j].profile == profile) return true;
+    return false;
+}
+
+void WriteBehind::writeLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        changed_.wait(lock, [&] { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty()) return;                  // Solo se sale con la cola vacía
+
+        Job job;
+        job.filename.swap(jobs_.front().filename);
+        job.data.swap(jobs_.front().data);
+        job.profile = jobs_.front().profile;
+        jobs_.pop_front();
+        writing_ = true;
+        writingProfile_ = job.profile;
+        lock.unlock();
+
+        // Igual que writePGMFile: temporal y luego renombrar
+        ProfileScope scope(job.profile);
+        PhaseTimer timer(Phase::FileWrite);
+        const std::string tmpName = temporaryName(job.filename);
+        FILE* file = std::fopen(tmpName.c_str(), "wb");
+        bool ok = file != nullptr;
+        if (ok) {
+            ok = std::fwrite(job.data.data(), 1, job.data.size(), file) == job.data.size();
+            ok = (std::fclose(file) == 0) && ok;
+        }
+        if (ok) ok = std::rename(tmpName.c_str(), job.filename.c_str()) == 0;
+        if (!ok) std::remove(tmpName.c_str());
+        else recordBytesWritten(job.data.size());
+        timer.stop();
+
+        lock.lock();
+        if (!ok) {
+            Failure failure = { job.filename, job.profile };
+            errors_.push_back(failure);
+        }
+        pendingBytes_ -= job.data.size();
+        writing_ = false;
+        writingProfile_ = nullptr;
+        changed_.notify_all();
+    }
+}
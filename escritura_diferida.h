@@ -0,0 +1,72 @@
+#ifndef ESCRITURA_DIFERIDA_H
+#define ESCRITURA_DIFERIDA_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "perfil.h"
+
+// ————————————
+// Escritura diferida de archivos.
+//
+// submit entrega el contenido completo de un archivo ya formateado y
+// vuelve enseguida; un hilo propio lo escribe en disco (en un temporal que
+// luego se renombra) mientras quien llama sigue con otro trabajo. Los
+// archivos se escriben en el orden en que se entregaron. Si lo pendiente
+// supera maxPending bytes, submit espera a que se libere lugar.
+//
+// Los errores no se pueden devolver en submit: quedan anotados y se
+// recuperan con takeErrors. flush espera a que no quede nada pendiente.
+//
+// Cada archivo queda a nombre de la sesión de quien lo entregó (ver
+// perfil.h): la escritura se mide en esa sesión, y flush y takeErrors solo
+// ven los archivos de la sesión que llama. Con el servidor, una conexión no
+// espera las escrituras de otra ni recibe sus errores. La sesión tiene que
+// llamar a flush antes de terminar.
+//————————————
+class WriteBehind {
+public:
+    explicit WriteBehind(size_t maxPending = size_t(256) << 20);
+    ~WriteBehind();                     // Termina de escribir lo pendiente
+
+    void submit(const std::string& filename, std::vector<char>& data);   // Toma data (queda vacío)
+    void flush();                       // Espera los archivos de la sesión actual
+
+    // Archivos de la sesión actual que no se pudieron escribir desde la última llamada.
+    std::vector<std::string> takeErrors();
+
+private:
+    WriteBehind(const WriteBehind&);              // No copiable
+    WriteBehind& operator=(const WriteBehind&);
+
+    struct Job {
+        std::string filename;
+        std::vector<char> data;
+        ProfileCounters* profile;       // Sesión de quien lo entregó
+    };
+
+    struct Failure {
+        std::string filename;
+        ProfileCounters* profile;
+    };
+
+    bool pendingFor(ProfileCounters* profile) const;    // Con mutex_ tomado
+    void writeLoop();
+
+    const size_t maxPending_;
+    size_t pendingBytes_;               // Bytes entregados y todavía no escritos
+    std::deque<Job> jobs_;
+    bool writing_;                      // El hilo está escribiendo un trabajo ya sacado de jobs_
+    ProfileCounters* writingProfile_;   // Sesión de ese trabajo
+    bool stopping_;
+    std::vector<Failure> errors_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::thread thread_;
+};
+
+#endif
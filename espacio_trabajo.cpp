@@ -0,0 +1,84 @@
+#include "espacio_trabajo.h"
+
+#include <algorithm>
+
+const size_t Workspace::kDefaultBudget;
+
+size_t VolumeSlot::sizeInBytes() const {
+    return data.sizeInBytes() + index.sizeInBytes() + packed.compressedBytes() + packed.cacheBytes();
+}
+
+void VolumeSlot::release() {
+    data.clear();
+    index.clear();
+    packed.clear();
+}
+
+Workspace::Workspace() : clock_(0), budget_(kDefaultBudget) {}
+
+ImageSlot* Workspace::findImage(const std::string& name) {
+    std::map<std::string, ImageSlot>::iterator it = images_.find(name);
+    return it == images_.end() ? nullptr : &it->second;
+}
+
+VolumeSlot* Workspace::findVolume(const std::string& name) {
+    std::map<std::string, VolumeSlot>::iterator it = volumes_.find(name);
+    return it == volumes_.end() ? nullptr : &it->second;
+}
+
+ImageSlot& Workspace::image(const std::string& name) { return images_[name]; }
+
+VolumeSlot& Workspace::volume(const std::string& name) { return volumes_[name]; }
+
+bool Workspace::removeImage(const std::string& name) { return images_.erase(name) > 0; }
+
+bool Workspace::removeVolume(const std::string& name) { return volumes_.erase(name) > 0; }
+
+size_t Workspace::residentBytes() const {
+    size_t total = 0;
+    for (std::map<std::string, ImageSlot>::const_iterator it = images_.begin(); it != images_.end(); ++it)
+        total += it->second.sizeInBytes();
+    for (std::map<std::string, VolumeSlot>::const_iterator it = volumes_.begin(); it != volumes_.end(); ++it)
+        total += it->second.sizeInBytes();
+    return total;
+}
+
+std::vector<std::string> Workspace::evict(size_t activeBytes) {
+    std::vector<std::string> evicted;
+    size_t total = activeBytes + residentBytes();
+    if (budget_ == 0 || total <= budget_) return evicted;
+
+    // Candidatas: las entradas con datos, de la usada hace más tiempo a la más reciente
+    struct Candidate {
+        uint64_t lastUse;
+        ImageSlot* image;
+        VolumeSlot* volume;
+        const std::string* name;
+        bool operator<(const Candidate& other) const { return lastUse < other.lastUse; }
+    };
+    std::vector<Candidate> candidates;
+    for (std::map<std::string, ImageSlot>::iterator it = images_.begin(); it != images_.end(); ++it)
+        if (it->second.sizeInBytes() > 0) {
+            Candidate c = { it->second.lastUse, &it->second, nullptr, &it->first };
+            candidates.push_back(c);
+        }
+    for (std::map<std::string, VolumeSlot>::iterator it = volumes_.begin(); it != volumes_.end(); ++it)
+        if (it->second.sizeInBytes() > 0) {
+            Candidate c = { it->second.lastUse, nullptr, &it->second, &it->first };
+            candidates.push_back(c);
+        }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (size_t c = 0; c < candidates.size() && total > budget_; ++c) {
+        if (candidates[c].image) {
+            total -= candidates[c].image->sizeInBytes();
+            candidates[c].image->release();
+            evicted.push_back("imagen " + *candidates[c].name);
+        } else {
+            total -= candidates[c].volume->sizeInBytes();
+            candidates[c].volume->release();
+            evicted.push_back("volumen " + *candidates[c].name);
+        }
+    }
+    return evicted;
+}
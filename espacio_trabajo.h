@@ -0,0 +1,89 @@
+#ifndef ESPACIO_TRABAJO_H
+#define ESPACIO_TRABAJO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "imagen.h"
+#include "indice_volumen.h"
+#include "volumen_comprimido.h"
+
+// ————————————
+// Espacio de trabajo: imágenes y volúmenes cargados con nombre.
+//
+// Cada entrada guarda sus datos y cómo volver a cargarlos (el archivo de la
+// imagen, o el nombre base, la cantidad de cortes y el modo del volumen).
+// La imagen y el volumen activos viven en el sistema mientras lo están y su
+// entrada queda vacía; al cambiar de activo los datos se intercambian sin
+// copiarlos. Con un límite de memoria, evict() descarta los datos de las
+// entradas usadas hace más tiempo: conservan el nombre y la receta, y el
+// sistema las vuelve a cargar cuando se las usa.
+//————————————
+struct ImageSlot {
+    std::string filename;           // Archivo del que se cargó
+    PixelBuffer data;               // Vacío si está activa o se descartó
+    uint64_t lastUse;
+
+    ImageSlot() : lastUse(0) {}
+    size_t sizeInBytes() const { return data.sizeInBytes(); }
+    void release() { data.clear(); }
+};
+
+struct VolumeSlot {
+    std::string base;               // Receta de cargar_volumen
+    int count;
+    bool compressed;
+    PixelBuffer data;               // Todo vacío si está activo o se descartó
+    VolumeIndex index;
+    CompressedVolume packed;
+    uint64_t lastUse;
+
+    VolumeSlot() : count(0), compressed(false), lastUse(0) {}
+    size_t sizeInBytes() const;
+    void release();
+};
+
+class Workspace {
+public:
+    static const size_t kDefaultBudget = size_t(1024) << 20;
+
+    Workspace();
+
+    // nullptr si no hay una entrada con ese nombre.
+    ImageSlot* findImage(const std::string& name);
+    VolumeSlot* findVolume(const std::string& name);
+
+    // La entrada con ese nombre; se crea vacía si no existe.
+    ImageSlot& image(const std::string& name);
+    VolumeSlot& volume(const std::string& name);
+
+    bool removeImage(const std::string& name);      // false si no existía
+    bool removeVolume(const std::string& name);
+
+    // Marca la entrada como la usada más recientemente.
+    void touch(ImageSlot& slot) { slot.lastUse = ++clock_; }
+    void touch(VolumeSlot& slot) { slot.lastUse = ++clock_; }
+
+    const std::map<std::string, ImageSlot>& images() const { return images_; }
+    const std::map<std::string, VolumeSlot>& volumes() const { return volumes_; }
+
+    size_t budget() const { return budget_; }
+    void setBudget(size_t bytes) { budget_ = bytes; }   // 0 = sin límite
+    size_t residentBytes() const;                       // Datos guardados en las entradas
+
+    // Descarta los datos de las entradas menos usadas hasta que
+    // residentBytes() + activeBytes quepa en el límite (o no quede ninguna
+    // con datos). Devuelve "imagen <nombre>" o "volumen <nombre>" por cada
+    // una, en el orden en que se descartaron.
+    std::vector<std::string> evict(size_t activeBytes);
+
+private:
+    std::map<std::string, ImageSlot> images_;
+    std::map<std::string, VolumeSlot> volumes_;
+    uint64_t clock_;
+    size_t budget_;
+};
+
+#endif
@@ -0,0 +1,453 @@
+#include "huffman.h"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+
+namespace {
+
+// Orden de la cola del formato anterior: primero el nodo de menor frecuencia.
+struct CompareFreq {
+    const std::vector<unsigned long>* freq;
+    bool operator()(int a, int b) const { return (*freq)[a] > (*freq)[b]; }
+};
+
+}  // namespace
+
+void buildHuffmanTree(const std::vector<unsigned long>& freq, HuffmanTree& tree) {
+    // Las frecuencias de los nodos internos se agregan detrás de las de los símbolos
+    const int symbols = static_cast<int>(freq.size());
+    std::vector<unsigned long> weight(freq);
+    weight.reserve(2 * symbols);
+    tree.nodes.clear();
+    tree.nodes.reserve(2 * symbols);
+
+    CompareFreq compare = { &weight };
+    std::priority_queue<int, std::vector<int>, CompareFreq> pq(compare);
+    for (int i = 0; i < symbols; ++i) {                                // Para cada símbolo
+        HuffmanTree::Node leaf = { i, -1, -1 };                        // crea un nodo y añade
+        tree.nodes.push_back(leaf);
+        pq.push(i);
+    }
+
+    while (pq.size() > 1) {                                            // Hasta que quede solo la raíz
+        int n1 = pq.top(); pq.pop();                                   // 1) Extrae nodo de menor freq
+        int n2 = pq.top(); pq.pop();                                   // 2) Extrae siguiente menor
+        HuffmanTree::Node parent = { -1, n1, n2 };                     // 3) Nodo interno suma freq
+        weight.push_back(weight[n1] + weight[n2]);
+        tree.nodes.push_back(parent);
+        pq.push(static_cast<int>(tree.nodes.size()) - 1);              // 4) Reinsertar
+    }
+    tree.root = pq.empty() ? -1 : pq.top();
+}
+
+// ————————————
+// Código canónico con longitud limitada
+//————————————
+void buildCodeLengths(const std::vector<unsigned long>& freq, int maxLength,
+                      std::vector<uint8_t>& lengths) {
+    lengths.assign(freq.size(), 0);
+
+    // Símbolos presentes ordenados por frecuencia creciente; en cada entrada
+    // los 32 bits altos son la frecuencia y los bajos el símbolo
+    std::vector<uint64_t> order;
+    for (size_t s = 0; s < freq.size(); ++s)
+        if (freq[s] > 0) order.push_back(static_cast<uint64_t>(freq[s]) << 32 | s);
+    const int n = static_cast<int>(order.size());
+    if (n == 0) return;
+    if (n == 1) {
+        lengths[order[0] & 0xffffffffu] = 1;
+        return;
+    }
+    std::sort(order.begin(), order.end());
+
+    // Longitudes óptimas sin árbol (Moffat y Katajainen): el arreglo guarda
+    // primero los pesos, luego los padres y al final la profundidad de cada hoja
+    std::vector<uint64_t> a(n);
+    for (int i = 0; i < n; ++i) a[i] = order[i] >> 32;
+    int root = 0, leaf = 2;
+    a[0] += a[1];
+    for (int next = 1; next < n - 1; ++next) {
+        if (leaf >= n || a[root] < a[leaf]) { a[next] = a[root]; a[root++] = next; }
+        else a[next] = a[leaf++];
+        if (leaf >= n || (root < next && a[root] < a[leaf])) { a[next] += a[root]; a[root++] = next; }
+        else a[next] += a[leaf++];
+    }
+    a[n - 2] = 0;
+    for (int next = n - 3; next >= 0; --next) a[next] = a[a[next]] + 1;
+    int available = 1, used = 0, depth = 0, next = n - 1;
+    root = n - 2;
+    while (available > 0) {
+        while (root >= 0 && a[root] == static_cast<uint64_t>(depth)) { ++used; --root; }
+        while (available > used) { a[next--] = depth; --available; }
+        available = 2 * used;
+        ++depth;
+        used = 0;
+    }
+
+    // Cantidad de códigos por longitud; los que pasan de maxLength se acortan
+    // como en JPEG: dos hojas del nivel más profundo suben y una hoja más
+    // corta baja un nivel para hacerles lugar
+    const int deepest = static_cast<int>(a[0]);
+    std::vector<int> count(std::max(deepest, maxLength) + 1, 0);
+    for (int i = 0; i < n; ++i) ++count[a[i]];
+    for (int len = deepest; len > maxLength; --len) {
+        while (count[len] > 0) {
+            int j = len - 2;
+            while (count[j] == 0) --j;
+            count[len] -= 2;
+            count[len - 1] += 1;
+            count[j + 1] += 2;
+            count[j] -= 1;
+        }
+    }
+
+    // Los menos frecuentes reciben los códigos más largos
+    int i = 0;
+    for (int len = maxLength; len >= 1; --len)
+        for (int c = 0; c < count[len]; ++c) lengths[order[i++] & 0xffffffffu] = static_cast<uint8_t>(len);
+}
+
+bool buildCanonicalTree(const std::vector<uint8_t>& lengths, HuffmanTree& tree) {
+    std::vector<HuffmanCode> codes;
+    buildCanonicalCodes(lengths, codes);
+
+    // Verificar la desigualdad de Kraft antes de insertar los códigos
+    uint64_t kraft = 0;
+    size_t used = 0;
+    for (size_t s = 0; s < lengths.size(); ++s) {
+        if (lengths[s] == 0) continue;
+        if (lengths[s] > 32) return false;
+        kraft += uint64_t(1) << (32 - lengths[s]);
+        ++used;
+    }
+    if (used == 0 || kraft > (uint64_t(1) << 32)) return false;
+
+    HuffmanTree::Node empty = { -1, -1, -1 };
+    tree.nodes.assign(1, empty);
+    tree.nodes.reserve(2 * used);
+    tree.root = 0;
+    for (size_t s = 0; s < codes.size(); ++s) {
+        const HuffmanCode& code = codes[s];
+        int node = 0;
+        for (int b = code.length - 1; b >= 0; --b) {
+            bool right = (code.bits >> b) & 1;
+            int child = right ? tree.nodes[node].right : tree.nodes[node].left;
+            if (child < 0) {
+                child = static_cast<int>(tree.nodes.size());
+                tree.nodes.push_back(empty);
+                if (right) tree.nodes[node].right = child;
+                else tree.nodes[node].left = child;
+            }
+            node = child;
+        }
+        if (code.length > 0) tree.nodes[node].symbol = static_cast<int>(s);
+    }
+    return true;
+}
+
+void buildCanonicalCodes(const std::vector<uint8_t>& lengths, std::vector<HuffmanCode>& codes) {
+    int maxLength = 0;
+    for (size_t s = 0; s < lengths.size(); ++s) maxLength = std::max<int>(maxLength, lengths[s]);
+    std::vector<uint64_t> next(maxLength + 2, 0);
+    std::vector<int> count(maxLength + 1, 0);
+    for (size_t s = 0; s < lengths.size(); ++s) ++count[lengths[s]];
+    count[0] = 0;
+
+    // Primer código de cada longitud
+    uint64_t code = 0;
+    for (int len = 1; len <= maxLength; ++len) {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
+    }
+
+    codes.assign(lengths.size(), HuffmanCode());
+    for (size_t s = 0; s < lengths.size(); ++s) {
+        codes[s].length = lengths[s];
+        codes[s].bits = lengths[s] ? next[lengths[s]]++ : 0;
+    }
+}
+
+// ————————————
+// Predictores
+//————————————
+namespace {
+
+struct PredictLeft {
+    static int at(int a, int, int) { return a; }
+};
+struct PredictUp {
+    static int at(int, int b, int) { return b; }
+};
+struct PredictAverage {
+    static int at(int a, int b, int) { return (a + b) >> 1; }
+};
+// c >= max(a, b) da min(a, b), c <= min(a, b) da max(a, b) y si no a + b - c;
+// es lo mismo que acotar a + b - c entre ambos, sin ramas
+struct PredictMed {
+    static int at(int a, int b, int c) {
+        const int lo = a < b ? a : b, hi = a < b ? b : a;
+        const int p = a + b - c;
+        return p < lo ? lo : p > hi ? hi : p;
+    }
+};
+
+template <typename T, typename P>
+void predictWith(const T* __restrict row, const T* __restrict above, int width, int symbols,
+                 T* __restrict out) {
+    if (width == 0) return;
+    int r = row[0] - (above ? above[0] : 0);
+    out[0] = static_cast<T>(r < 0 ? r + symbols : r);
+    if (!above) {
+        for (int j = 1; j < width; ++j) {
+            r = row[j] - row[j - 1];
+            out[j] = static_cast<T>(r < 0 ? r + symbols : r);
+        }
+        return;
+    }
+    for (int j = 1; j < width; ++j) {
+        r = row[j] - P::at(row[j - 1], above[j], above[j - 1]);
+        out[j] = static_cast<T>(r < 0 ? r + symbols : r);
+    }
+}
+
+template <typename T, typename P>
+void unpredictWith(T* __restrict row, const T* __restrict above, int width, int symbols) {
+    if (width == 0) return;
+    int x = row[0] + (above ? above[0] : 0);
+    row[0] = static_cast<T>(x >= symbols ? x - symbols : x);
+    for (int j = 1; j < width; ++j) {
+        x = row[j] + (above ? P::at(row[j - 1], above[j], above[j - 1]) : row[j - 1]);
+        row[j] = static_cast<T>(x >= symbols ? x - symbols : x);
+    }
+}
+
+template <typename T>
+void predictAny(Predictor predictor, const T* row, const T* above, int width, int maxValue, T* out) {
+    switch (predictor) {
+    case Predictor::Left:    predictWith<T, PredictLeft>(row, above, width, maxValue + 1, out); break;
+    case Predictor::Up:      predictWith<T, PredictUp>(row, above, width, maxValue + 1, out); break;
+    case Predictor::Average: predictWith<T, PredictAverage>(row, above, width, maxValue + 1, out); break;
+    case Predictor::Med:     predictWith<T, PredictMed>(row, above, width, maxValue + 1, out); break;
+    default:                 std::memcpy(out, row, width * sizeof(T)); break;
+    }
+}
+
+template <typename T>
+void unpredictAny(Predictor predictor, T* row, const T* above, int width, int maxValue) {
+    switch (predictor) {
+    case Predictor::Left:    unpredictWith<T, PredictLeft>(row, above, width, maxValue + 1); break;
+    case Predictor::Up:      unpredictWith<T, PredictUp>(row, above, width, maxValue + 1); break;
+    case Predictor::Average: unpredictWith<T, PredictAverage>(row, above, width, maxValue + 1); break;
+    case Predictor::Med:     unpredictWith<T, PredictMed>(row, above, width, maxValue + 1); break;
+    default:                 break;
+    }
+}
+
+const char* const kPredictorNames[] = { "ninguno", "izq", "arriba", "prom", "med", "auto" };
+
+}  // namespace
+
+bool parsePredictor(const std::string& name, Predictor& predictor) {
+    for (int p = 0; p <= static_cast<int>(Predictor::Auto); ++p) {
+        if (name == kPredictorNames[p]) {
+            predictor = static_cast<Predictor>(p);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* predictorName(Predictor predictor) {
+    return kPredictorNames[static_cast<int>(predictor)];
+}
+
+void predictRow(Predictor predictor, const uint8_t* row, const uint8_t* above, int width,
+                int maxValue, uint8_t* out) {
+    predictAny(predictor, row, above, width, maxValue, out);
+}
+
+void predictRow(Predictor predictor, const uint16_t* row, const uint16_t* above, int width,
+                int maxValue, uint16_t* out) {
+    predictAny(predictor, row, above, width, maxValue, out);
+}
+
+void unpredictRow(Predictor predictor, uint8_t* row, const uint8_t* above, int width, int maxValue) {
+    unpredictAny(predictor, row, above, width, maxValue);
+}
+
+void unpredictRow(Predictor predictor, uint16_t* row, const uint16_t* above, int width, int maxValue) {
+    unpredictAny(predictor, row, above, width, maxValue);
+}
+
+namespace {
+
+template <typename T>
+void encodeRows(const PixelBuffer& image, const std::vector<HuffmanCode>& codes, BitWriter& out,
+                int rowBegin, int rowEnd, Predictor predictor) {
+    const HuffmanCode* table = codes.data();
+    const int width = image.width();
+    std::vector<T> residuals(predictor == Predictor::None ? 0 : width);
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        const T* row = image.row<T>(0, i);
+        if (predictor != Predictor::None) {
+            predictRow(predictor, row, i > rowBegin ? image.row<T>(0, i - 1) : nullptr, width,
+                       image.maxValue(), residuals.data());
+            row = residuals.data();
+        }
+        for (int j = 0; j < width; ++j) {
+            const HuffmanCode& code = table[row[j]];
+            out.put(code.bits, code.length);
+        }
+    }
+}
+
+}  // namespace
+
+void BitWriter::flushWord() {
+    unsigned char word[4] = {
+        static_cast<unsigned char>(acc_ >> 56), static_cast<unsigned char>(acc_ >> 48),
+        static_cast<unsigned char>(acc_ >> 40), static_cast<unsigned char>(acc_ >> 32)
+    };
+    out_.insert(out_.end(), word, word + 4);
+    acc_ <<= 32;
+    count_ -= 32;
+}
+
+void BitWriter::finish() {
+    while (count_ > 0) {
+        out_.push_back(static_cast<unsigned char>(acc_ >> 56));
+        acc_ <<= 8;
+        count_ -= 8;
+    }
+    count_ = 0;
+    acc_ = 0;
+}
+
+void encodePixels(const PixelBuffer& image, const std::vector<HuffmanCode>& codes,
+                  std::vector<unsigned char>& out, int rowBegin, int rowEnd, Predictor predictor) {
+    BitWriter writer(out);
+    if (image.wide()) encodeRows<uint16_t>(image, codes, writer, rowBegin, rowEnd, predictor);
+    else encodeRows<uint8_t>(image, codes, writer, rowBegin, rowEnd, predictor);
+    writer.finish();
+}
+
+namespace {
+
+// ————————————
+// Lector de bits MSB primero sobre un buffer en memoria. Mantiene entre 56 y
+// 63 bits válidos en la parte alta de un acumulador de 64 bits; pasado el
+// final del buffer entran ceros, y bitsLeft() indica cuántos bits reales quedan.
+//————————————
+class BitReader {
+public:
+    BitReader(const unsigned char* data, size_t size)
+      : p_(data), end_(data + size), bits_(0), count_(0), left_(static_cast<uint64_t>(size) * 8) {}
+
+    void refill() {
+        if (end_ - p_ >= 8) {
+            // Carga de 8 bytes sin ramas; los bits sobrantes se vuelven a cargar después
+            uint64_t word;
+            std::memcpy(&word, p_, 8);
+            word = __builtin_bswap64(word);
+            bits_ |= word >> count_;
+            p_ += (63 - count_) >> 3;
+            count_ |= 56;
+        } else {
+            while (count_ <= 56) {
+                uint64_t byte = p_ < end_ ? *p_++ : 0;
+                bits_ |= byte << (56 - count_);
+                count_ += 8;
+            }
+        }
+    }
+
+    uint32_t peek(int n) const { return static_cast<uint32_t>(bits_ >> (64 - n)); }
+    void consume(int n) { bits_ <<= n; count_ -= n; left_ -= n; }
+    uint64_t bitsLeft() const { return left_; }
+
+private:
+    const unsigned char* p_;
+    const unsigned char* end_;
+    uint64_t bits_;
+    int count_;
+    uint64_t left_;
+};
+
+}  // namespace
+
+const int HuffmanDecoder::kPrimaryBits;
+const uint32_t HuffmanDecoder::kFallback;
+const uint32_t HuffmanDecoder::kInvalid;
+
+HuffmanDecoder::HuffmanDecoder(const HuffmanTree& tree)
+  : table_(1u << kPrimaryBits, kInvalid), nodes_(tree.nodes) {
+    if (tree.root >= 0) fill(tree.root, 0, 0);
+}
+
+// Recorre el árbol hasta kPrimaryBits de profundidad llenando la tabla.
+void HuffmanDecoder::fill(int node, uint32_t prefix, int depth) {
+    if (node < 0) return;                    // Código incompleto: queda kInvalid
+    const HuffmanTree::Node& n = nodes_[node];
+    if (n.symbol >= 0) {
+        // Hoja: todas las entradas que empiezan con su código la resuelven
+        uint32_t span = 1u << (kPrimaryBits - depth);
+        uint32_t start = prefix << (kPrimaryBits - depth);
+        uint32_t entry = static_cast<uint32_t>(n.symbol) | (static_cast<uint32_t>(depth) << 16);
+        for (uint32_t e = 0; e < span; ++e) table_[start + e] = entry;
+    } else if (depth == kPrimaryBits) {
+        table_[prefix] = kFallback | static_cast<uint32_t>(node);
+    } else {
+        fill(n.left, prefix << 1, depth + 1);
+        fill(n.right, (prefix << 1) | 1, depth + 1);
+    }
+}
+
+template <typename T>
+size_t HuffmanDecoder::decodeInto(const unsigned char* data, size_t size, PixelBuffer& image,
+                                  int rowBegin, int rowEnd, Predictor predictor) const {
+    BitReader in(data, size);
+    const int width = image.width();
+    size_t decoded = 0;
+
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        T* row = image.row<T>(0, i);
+        for (int j = 0; j < width; ++j) {
+            in.refill();
+            uint32_t entry = table_[in.peek(kPrimaryBits)];
+
+            if (!(entry & kFallback)) {
+                int length = static_cast<int>(entry >> 16);
+                if (static_cast<uint64_t>(length) > in.bitsLeft()) return decoded;
+                in.consume(length);
+                row[j] = static_cast<T>(entry & 0xffff);
+            } else {
+                // Código largo: seguir el árbol desde el nodo alcanzado
+                if (entry == kInvalid || static_cast<uint64_t>(kPrimaryBits) > in.bitsLeft())
+                    return decoded;
+                in.consume(kPrimaryBits);
+                const HuffmanTree::Node* node = &nodes_[entry & ~kFallback];
+                while (node->symbol < 0) {
+                    if (in.bitsLeft() == 0) return decoded;
+                    in.refill();
+                    int child = in.peek(1) ? node->right : node->left;
+                    in.consume(1);
+                    if (child < 0) return decoded;
+                    node = &nodes_[child];
+                }
+                row[j] = static_cast<T>(node->symbol);
+            }
+            ++decoded;
+        }
+        if (predictor != Predictor::None)
+            unpredictRow(predictor, row, i > rowBegin ? image.row<T>(0, i - 1) : nullptr, width,
+                         image.maxValue());
+    }
+    return decoded;
+}
+
+size_t HuffmanDecoder::decode(const unsigned char* data, size_t size, PixelBuffer& image,
+                              int rowBegin, int rowEnd, Predictor predictor) const {
+    if (image.wide()) return decodeInto<uint16_t>(data, size, image, rowBegin, rowEnd, predictor);
+    return decodeInto<uint8_t>(data, size, image, rowBegin, rowEnd, predictor);
+}
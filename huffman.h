@@ -0,0 +1,162 @@
+#ifndef HUFFMAN_H
+#define HUFFMAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "imagen.h"
+
+// ————————————
+// Árbol de Huffman guardado en un arreglo de nodos que se referencian por
+// índice: se reserva de una vez y se libera con el vector, sin nodos sueltos.
+//————————————
+struct HuffmanTree {
+    struct Node {
+        int symbol;         // Valor de intensidad (0..M) o -1 si es nodo interno
+        int left;           // Índice del hijo izquierdo (-1 si falta)
+        int right;          // Índice del hijo derecho (-1 si falta)
+    };
+    std::vector<Node> nodes;
+    int root;
+
+    HuffmanTree() : root(-1) {}
+};
+
+// Árbol del formato anterior: se combinan siempre los dos nodos de menor
+// frecuencia, incluidos los símbolos de frecuencia cero, en el mismo orden
+// que usaba el codificador original (necesario para leer sus archivos).
+void buildHuffmanTree(const std::vector<unsigned long>& freq, HuffmanTree& tree);
+
+// Longitud del código canónico de cada símbolo, de a lo sumo maxLength bits.
+// Los símbolos que no aparecen quedan con longitud 0; si aparece uno solo
+// recibe longitud 1.
+void buildCodeLengths(const std::vector<unsigned long>& freq, int maxLength,
+                      std::vector<uint8_t>& lengths);
+
+// Árbol del código canónico con esas longitudes. Devuelve false si las
+// longitudes no forman un código prefijo válido.
+bool buildCanonicalTree(const std::vector<uint8_t>& lengths, HuffmanTree& tree);
+
+// Código de un símbolo como entero: los length bits bajos de bits, MSB primero.
+// length == 0 marca un símbolo sin código; nunca se emite.
+struct HuffmanCode {
+    uint64_t bits;
+    int length;
+};
+
+// Códigos canónicos: por longitud creciente y, a igual longitud, por símbolo.
+void buildCanonicalCodes(const std::vector<uint8_t>& lengths, std::vector<HuffmanCode>& codes);
+
+// ————————————
+// Predicción espacial antes de Huffman.
+//
+// Con un predictor se codifica, en lugar de cada píxel x, el residuo
+// (x - p) módulo M + 1, donde p se calcula con los vecinos ya codificados:
+// a = izquierda, b = arriba, c = arriba a la izquierda. En imágenes suaves
+// los residuos se concentran cerca de 0 (y de M, los negativos) y el
+// código resulta más corto. El alfabeto sigue siendo 0..M, así que el
+// modelo y el decodificador no cambian.
+//
+// En la primera fila de cada tramo codificado (por ejemplo un bloque del
+// .huf) se predice con a, y en la primera columna con b; el primer píxel
+// del tramo se predice con 0. Así cada tramo se decodifica por separado.
+//————————————
+enum class Predictor {
+    None,       // Sin predicción
+    Left,       // a
+    Up,         // b
+    Average,    // (a + b) / 2
+    Med,        // Mediana de a, b y a + b - c (LOCO-I / JPEG-LS)
+    Auto        // Solo al codificar: el de menor tamaño estimado
+};
+
+bool parsePredictor(const std::string& name, Predictor& predictor);
+const char* predictorName(Predictor predictor);
+
+// Residuos de los width píxeles de row en out; above es la fila anterior
+// del tramo, o nullptr en su primera fila.
+void predictRow(Predictor predictor, const uint8_t* row, const uint8_t* above, int width,
+                int maxValue, uint8_t* out);
+void predictRow(Predictor predictor, const uint16_t* row, const uint16_t* above, int width,
+                int maxValue, uint16_t* out);
+
+// Inversa de predictRow sobre row, en el lugar.
+void unpredictRow(Predictor predictor, uint8_t* row, const uint8_t* above, int width, int maxValue);
+void unpredictRow(Predictor predictor, uint16_t* row, const uint16_t* above, int width, int maxValue);
+
+// ————————————
+// Escritor de bits MSB primero. Los códigos se acumulan en un entero de 64
+// bits y se vuelcan al buffer de salida de a palabras de 32 bits.
+//————————————
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<unsigned char>& out) : out_(out), acc_(0), count_(0) {}
+
+    void put(uint64_t bits, int length) {
+        if (length == 0) return;
+        if (length > 32) {                  // Solo códigos muy largos: en dos partes
+            put(bits >> 32, length - 32);
+            bits &= 0xffffffffu;
+            length = 32;
+        }
+        acc_ |= bits << (64 - count_ - length);
+        count_ += length;
+        if (count_ >= 32) flushWord();
+    }
+
+    // Vuelca los bits pendientes completando el último byte con ceros.
+    void finish();
+
+private:
+    void flushWord();
+
+    std::vector<unsigned char>& out_;
+    uint64_t acc_;      // Bits pendientes, alineados a la izquierda
+    int count_;         // Cantidad de bits pendientes (< 32 entre llamadas)
+};
+
+// Codifica las filas [rowBegin, rowEnd) de image agregándolas a out. El
+// último byte se completa con ceros. Con un predictor, cada fila se
+// convierte en residuos justo antes de emitir sus códigos.
+void encodePixels(const PixelBuffer& image, const std::vector<HuffmanCode>& codes,
+                  std::vector<unsigned char>& out, int rowBegin, int rowEnd,
+                  Predictor predictor = Predictor::None);
+
+// ————————————
+// Decodificador de Huffman por tablas.
+//
+// Una tabla primaria indexada por los próximos kPrimaryBits bits del flujo
+// da directamente el símbolo y la longitud de su código, así que en cada
+// paso se resuelven varios bits a la vez. Los códigos más largos (poco
+// frecuentes por construcción) apuntan al nodo del árbol alcanzado tras
+// esos bits y se terminan de recorrer bit a bit. El flujo se lee de un
+// buffer en bloque, con un acumulador de 64 bits.
+//————————————
+class HuffmanDecoder {
+public:
+    static const int kPrimaryBits = 11;
+
+    explicit HuffmanDecoder(const HuffmanTree& tree);
+
+    // Decodifica los bits de data (MSB primero) en las filas [rowBegin, rowEnd)
+    // de image. Devuelve cuántos píxeles se completaron antes de agotar los datos.
+    // Con un predictor, cada fila se reconstruye apenas termina de decodificarse.
+    size_t decode(const unsigned char* data, size_t size, PixelBuffer& image,
+                  int rowBegin, int rowEnd, Predictor predictor = Predictor::None) const;
+
+private:
+    void fill(int node, uint32_t prefix, int depth);
+    template <typename T>
+    size_t decodeInto(const unsigned char* data, size_t size, PixelBuffer& image,
+                      int rowBegin, int rowEnd, Predictor predictor) const;
+
+    // Entrada de la tabla: símbolo | longitud << 16, kFallback | índice del nodo
+    // alcanzado, o kInvalid si ningún código empieza con esos bits
+    static const uint32_t kFallback = 0x80000000u;
+    static const uint32_t kInvalid = 0xffffffffu;
+    std::vector<uint32_t> table_;
+    std::vector<HuffmanTree::Node> nodes_;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "imagen.h"
+
+PixelBuffer::PixelBuffer()
+  : width_(0), height_(0), depth_(0), maxValue_(0),
+    bytesPerPixel_(1), rowStride_(0), sliceStride_(0), external_(nullptr) {}
+
+void PixelBuffer::allocate(int width, int height, int depth, int maxValue) {
+    width_ = width;
+    height_ = height;
+    depth_ = depth;
+    maxValue_ = maxValue;
+    bytesPerPixel_ = (maxValue > 255) ? 2 : 1;
+    rowStride_ = static_cast<size_t>(width);
+    sliceStride_ = rowStride_ * height;
+    external_ = nullptr;
+    owner_.reset();
+
+    // assign() reutiliza la capacidad previa si alcanza y deja todo en cero (negro)
+    storage_.assign(sliceStride_ * depth * bytesPerPixel_, 0);
+}
+
+void PixelBuffer::clear() {
+    width_ = height_ = depth_ = maxValue_ = 0;
+    bytesPerPixel_ = 1;
+    rowStride_ = sliceStride_ = 0;
+    std::vector<unsigned char>().swap(storage_);
+    external_ = nullptr;
+    owner_.reset();
+}
+
+void PixelBuffer::wrap(int width, int height, int depth, int maxValue, size_t rowStride,
+                       unsigned char* pixels, const std::shared_ptr<void>& owner) {
+    std::vector<unsigned char>().swap(storage_);
+    width_ = width;
+    height_ = height;
+    depth_ = depth;
+    maxValue_ = maxValue;
+    bytesPerPixel_ = (maxValue > 255) ? 2 : 1;
+    rowStride_ = rowStride;
+    sliceStride_ = rowStride * height;
+    external_ = pixels;
+    owner_ = owner;
+}
@@ -0,0 +1,78 @@
+#ifndef IMAGEN_H
+#define IMAGEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// ————————————
+// Buffer contiguo de píxeles para imágenes y volúmenes.
+//
+// Una imagen es un buffer con depth == 1. El tipo de píxel se elige al
+// reservar según el valor máximo: uint8_t si M <= 255 y uint16_t si es mayor.
+// Las filas y los cortes se direccionan con rowStride y sliceStride,
+// expresados en píxeles.
+//
+// Los píxeles pueden vivir en memoria propia o en memoria externa (por
+// ejemplo un archivo proyectado con mmap) que se envuelve sin copiarla.
+//————————————
+class PixelBuffer {
+public:
+    PixelBuffer();
+
+    void allocate(int width, int height, int depth, int maxValue);  // Reserva y llena con ceros
+    void clear();
+
+    // Envuelve píxeles externos sin copiarlos; owner mantiene viva esa memoria.
+    void wrap(int width, int height, int depth, int maxValue, size_t rowStride,
+              unsigned char* pixels, const std::shared_ptr<void>& owner);
+    bool isWrapped() const { return external_ != nullptr; }
+
+    bool empty() const { return depth_ == 0; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int depth() const { return depth_; }
+    int maxValue() const { return maxValue_; }
+    void setMaxValue(int m) { maxValue_ = m; }
+
+    bool wide() const { return bytesPerPixel_ == 2; }   // true si los píxeles son uint16_t
+    int bytesPerPixel() const { return bytesPerPixel_; }
+    size_t rowStride() const { return rowStride_; }
+    size_t sliceStride() const { return sliceStride_; }
+    size_t sizeInBytes() const { return sliceStride_ * depth_ * bytesPerPixel_; }
+
+    unsigned char* data() { return external_ ? external_ : storage_.data(); }
+    const unsigned char* data() const { return external_ ? external_ : storage_.data(); }
+
+    // Acceso tipado; T debe coincidir con el tipo de píxel (ver wide()).
+    template <typename T> T* slice(int k) {
+        return reinterpret_cast<T*>(data()) + k * sliceStride_;
+    }
+    template <typename T> const T* slice(int k) const {
+        return reinterpret_cast<const T*>(data()) + k * sliceStride_;
+    }
+    template <typename T> T* row(int k, int i) { return slice<T>(k) + i * rowStride_; }
+    template <typename T> const T* row(int k, int i) const { return slice<T>(k) + i * rowStride_; }
+
+    // Acceso genérico (más lento); útil fuera de los bucles críticos.
+    int at(int k, int i, int j) const {
+        size_t idx = k * sliceStride_ + i * rowStride_ + j;
+        return wide() ? reinterpret_cast<const uint16_t*>(data())[idx] : data()[idx];
+    }
+    void set(int k, int i, int j, int v) {
+        size_t idx = k * sliceStride_ + i * rowStride_ + j;
+        if (wide()) reinterpret_cast<uint16_t*>(data())[idx] = static_cast<uint16_t>(v);
+        else data()[idx] = static_cast<unsigned char>(v);
+    }
+
+private:
+    int width_, height_, depth_, maxValue_;
+    int bytesPerPixel_;
+    size_t rowStride_, sliceStride_;
+    std::vector<unsigned char> storage_;   // Memoria propia (vacía si está envuelto)
+    unsigned char* external_;              // Píxeles externos, o nullptr
+    std::shared_ptr<void> owner_;          // Dueño de la memoria externa
+};
+
+#endif
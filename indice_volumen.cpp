@@ -0,0 +1,420 @@
+#include "indice_volumen.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const int kRangeBlock = 16;             // Posiciones del eje por bloque
+
+// ————————————
+// Geometría de una dirección. Cada posición t del eje tiene un plano de
+// planeRows filas de rowLength píxeles, en el mismo orden que la salida de
+// projectVolume: z -> (i, j), y -> (k, j), x -> (i, k).
+//————————————
+struct AxisShape {
+    int length;                         // Posiciones a lo largo del eje
+    int planeRows, rowLength;
+    size_t plane() const { return static_cast<size_t>(planeRows) * rowLength; }
+};
+
+AxisShape shapeOf(int width, int height, int depth, ProjectionAxis axis) {
+    AxisShape shape = { depth, height, width };
+    if (axis == ProjectionAxis::Y) { shape.length = height; shape.planeRows = depth; }
+    else if (axis == ProjectionAxis::X) { shape.length = width; shape.rowLength = depth; }
+    return shape;
+}
+
+int axisSlot(ProjectionAxis axis) {
+    return axis == ProjectionAxis::X ? 0 : axis == ProjectionAxis::Y ? 1 : 2;
+}
+
+// Copia a dst la fila r del plano de la posición t.
+template <typename T>
+void gatherRow(const PixelBuffer& volume, ProjectionAxis axis, int t, int r, T* __restrict dst) {
+    switch (axis) {
+    case ProjectionAxis::Z:
+        std::memcpy(dst, volume.row<T>(t, r), volume.width() * sizeof(T));
+        break;
+    case ProjectionAxis::Y:
+        std::memcpy(dst, volume.row<T>(r, t), volume.width() * sizeof(T));
+        break;
+    case ProjectionAxis::X:
+        for (int k = 0; k < volume.depth(); ++k) dst[k] = volume.row<T>(k, r)[t];
+        break;
+    }
+}
+
+template <typename T>
+struct MaxPick {
+    static T pick(T a, T b) { return a > b ? a : b; }
+};
+
+template <typename T>
+struct MinPick {
+    static T pick(T a, T b) { return a < b ? a : b; }
+};
+
+template <typename T, typename Op>
+void combine(T* __restrict acc, const T* __restrict row, size_t n) {
+    for (size_t p = 0; p < n; ++p) acc[p] = Op::pick(acc[p], row[p]);
+}
+
+template <typename T>
+T* plane(std::vector<unsigned char>& bytes, size_t plane, size_t t) {
+    return reinterpret_cast<T*>(bytes.data()) + t * plane;
+}
+
+template <typename T>
+const T* plane(const std::vector<unsigned char>& bytes, size_t plane, size_t t) {
+    return reinterpret_cast<const T*>(bytes.data()) + t * plane;
+}
+
+}  // namespace
+
+// ————————————
+// Tabla de rangos de una dirección y un criterio. prefix[t] es el
+// resultado desde el inicio del bloque de t hasta t, suffix[t] desde t
+// hasta el final de su bloque, y levels[l][b] el de los bloques
+// [b, b + 2^l). Cada entrada es un plano completo de valores T.
+//————————————
+struct VolumeIndex::RangeTable {
+    AxisShape shape;
+    int blocks;
+    std::vector<unsigned char> prefix, suffix;
+    std::vector<std::vector<unsigned char> > levels;
+
+    size_t sizeInBytes() const {
+        size_t total = prefix.size() + suffix.size();
+        for (size_t l = 0; l < levels.size(); ++l) total += levels[l].size();
+        return total;
+    }
+};
+
+namespace {
+
+template <typename T, typename Op>
+void buildRangeTable(const PixelBuffer& volume, ProjectionAxis axis, VolumeIndex::RangeTable& table,
+                     ThreadPool& pool) {
+    const AxisShape shape = table.shape;
+    const size_t P = shape.plane();
+    const int n = shape.length;
+    table.blocks = (n + kRangeBlock - 1) / kRangeBlock;
+    table.prefix.assign(n * P * sizeof(T), 0);
+    table.suffix.assign(n * P * sizeof(T), 0);
+
+    // Valores del volumen reordenados con el eje por fuera
+    pool.parallelFor(0, n, pool.grainFor(n), [&](size_t b, size_t e) {
+        for (size_t t = b; t < e; ++t) {
+            T* dst = plane<T>(table.prefix, P, t);
+            for (int r = 0; r < shape.planeRows; ++r)
+                gatherRow<T>(volume, axis, static_cast<int>(t), r, dst + r * shape.rowLength);
+            std::memcpy(plane<T>(table.suffix, P, t), dst, P * sizeof(T));
+        }
+    });
+
+    // Acumulados dentro de cada bloque, hacia adelante y hacia atrás
+    const int blocks = table.blocks;
+    pool.parallelFor(0, blocks, 1, [&](size_t b, size_t e) {
+        for (size_t blk = b; blk < e; ++blk) {
+            const int first = static_cast<int>(blk) * kRangeBlock;
+            const int last = std::min(n, first + kRangeBlock) - 1;
+            for (int t = first + 1; t <= last; ++t)
+                combine<T, Op>(plane<T>(table.prefix, P, t), plane<T>(table.prefix, P, t - 1), P);
+            for (int t = last - 1; t >= first; --t)
+                combine<T, Op>(plane<T>(table.suffix, P, t), plane<T>(table.suffix, P, t + 1), P);
+        }
+    });
+
+    // Tabla dispersa sobre los bloques; el nivel 0 es el prefijo del final de cada bloque
+    table.levels.assign(1, std::vector<unsigned char>(blocks * P * sizeof(T)));
+    for (int blk = 0; blk < blocks; ++blk) {
+        const int last = std::min(n, (blk + 1) * kRangeBlock) - 1;
+        std::memcpy(plane<T>(table.levels[0], P, blk), plane<T>(table.prefix, P, last), P * sizeof(T));
+    }
+    for (int span = 2; span <= blocks; span *= 2) {
+        const std::vector<unsigned char>& below = table.levels.back();
+        std::vector<unsigned char> level(below.begin(), below.begin() + (blocks - span + 1) * P * sizeof(T));
+        const int half = span / 2;
+        pool.parallelFor(0, blocks - span + 1, pool.grainFor(blocks - span + 1), [&](size_t b, size_t e) {
+            for (size_t blk = b; blk < e; ++blk)
+                combine<T, Op>(plane<T>(level, P, blk), plane<T>(below, P, blk + half), P);
+        });
+        table.levels.push_back(std::vector<unsigned char>());
+        table.levels.back().swap(level);
+    }
+}
+
+template <typename T, typename Op>
+void queryRangeTable(const PixelBuffer& volume, ProjectionAxis axis, const VolumeIndex::RangeTable& table,
+                     int begin, int end, PixelBuffer& result, ThreadPool& pool) {
+    const AxisShape shape = table.shape;
+    const size_t P = shape.plane();
+    const int firstBlock = begin / kRangeBlock, lastBlock = end / kRangeBlock;
+    const int inner = lastBlock - firstBlock - 1;             // Bloques enteros entre los extremos
+    int level = 0;
+    while ((2 << level) <= inner) ++level;
+
+    pool.parallelFor(0, shape.planeRows, pool.grainFor(shape.planeRows), [&](size_t b, size_t e) {
+        const size_t n = shape.rowLength;
+        std::vector<T> row(firstBlock == lastBlock ? n : 0);
+        for (size_t r = b; r < e; ++r) {
+            T* out = result.row<T>(0, static_cast<int>(r));
+            const size_t offset = r * n;
+            if (firstBlock == lastBlock) {
+                // Dentro de un bloque: a lo sumo kRangeBlock filas del volumen
+                const bool fromStart = begin % kRangeBlock == 0;
+                const bool toEnd = end % kRangeBlock == kRangeBlock - 1 || end == shape.length - 1;
+                if (fromStart) {
+                    std::memcpy(out, plane<T>(table.prefix, P, end) + offset, n * sizeof(T));
+                } else if (toEnd) {
+                    std::memcpy(out, plane<T>(table.suffix, P, begin) + offset, n * sizeof(T));
+                } else {
+                    gatherRow<T>(volume, axis, begin, static_cast<int>(r), out);
+                    for (int t = begin + 1; t <= end; ++t) {
+                        gatherRow<T>(volume, axis, t, static_cast<int>(r), row.data());
+                        combine<T, Op>(out, row.data(), n);
+                    }
+                }
+                continue;
+            }
+            std::memcpy(out, plane<T>(table.suffix, P, begin) + offset, n * sizeof(T));
+            combine<T, Op>(out, plane<T>(table.prefix, P, end) + offset, n);
+            if (inner > 0) {
+                const std::vector<unsigned char>& blocks = table.levels[level];
+                combine<T, Op>(out, plane<T>(blocks, P, firstBlock + 1) + offset, n);
+                combine<T, Op>(out, plane<T>(blocks, P, lastBlock - (1 << level)) + offset, n);
+            }
+        }
+    });
+}
+
+// ————————————
+// Tabla de sumas 3D. S[k][i][j] con k en [0, depth], i en [0, height],
+// j en [0, width]; las entradas con algún índice 0 valen cero.
+//————————————
+template <typename S>
+struct SumTable {
+    const S* data;
+    size_t rowStride, sliceStride;
+
+    S at(int k, int i, int j) const { return data[k * sliceStride + i * rowStride + j]; }
+
+    // Suma de [k0, k1) x [i0, i1) x [j0, j1). Con aritmética sin signo el
+    // resultado es exacto aunque los términos intermedios den la vuelta.
+    S box(int k0, int k1, int i0, int i1, int j0, int j1) const {
+        return at(k1, i1, j1) - at(k0, i1, j1) - at(k1, i0, j1) - at(k1, i1, j0)
+             + at(k0, i0, j1) + at(k0, i1, j0) + at(k1, i0, j0) - at(k0, i0, j0);
+    }
+};
+
+template <typename T, typename S>
+void buildSumTable(const PixelBuffer& volume, std::vector<S>& sums, ThreadPool& pool) {
+    const int width = volume.width(), height = volume.height(), depth = volume.depth();
+    const size_t rowStride = width + 1, sliceStride = rowStride * (height + 1);
+    sums.assign(sliceStride * (depth + 1), 0);
+
+    // Sumas 2D de cada corte
+    pool.parallelFor(1, depth + 1, pool.grainFor(depth), [&](size_t b, size_t e) {
+        for (size_t k = b; k < e; ++k) {
+            S* slice = sums.data() + k * sliceStride;
+            for (int i = 1; i <= height; ++i) {
+                const T* src = volume.row<T>(static_cast<int>(k) - 1, i - 1);
+                const S* above = slice + (i - 1) * rowStride;
+                S* row = slice + i * rowStride;
+                S running = 0;
+                for (int j = 0; j < width; ++j) {
+                    running += src[j];
+                    row[j + 1] = running + above[j + 1];
+                }
+            }
+        }
+    });
+
+    // Acumulado entre cortes, fila a fila
+    pool.parallelFor(1, height + 1, pool.grainFor(height), [&](size_t b, size_t e) {
+        for (int k = 1; k <= depth; ++k) {
+            for (size_t i = b; i < e; ++i) {
+                S* __restrict row = sums.data() + k * sliceStride + i * rowStride;
+                const S* __restrict prev = row - sliceStride;
+                for (size_t j = 1; j < rowStride; ++j) row[j] += prev[j];
+            }
+        }
+    });
+}
+
+template <typename T, typename S>
+void querySumTable(const std::vector<S>& sums, int width, int height, ProjectionAxis axis,
+                   int begin, int end, PixelBuffer& result, ThreadPool& pool) {
+    const SumTable<S> table = { sums.data(), static_cast<size_t>(width) + 1,
+                                (static_cast<size_t>(width) + 1) * (height + 1) };
+    const int count = end - begin + 1, rows = result.height(), n = result.width();
+    const int k1 = end + 1;
+    pool.parallelFor(0, rows, pool.grainFor(rows), [&](size_t b, size_t e) {
+        for (size_t rr = b; rr < e; ++rr) {
+            const int r = static_cast<int>(rr);
+            T* out = result.row<T>(0, r);
+            switch (axis) {
+            case ProjectionAxis::Z:         // Salida (i, j)
+                for (int j = 0; j < n; ++j)
+                    out[j] = static_cast<T>(table.box(begin, k1, r, r + 1, j, j + 1) / count);
+                break;
+            case ProjectionAxis::Y:         // Salida (k, j)
+                for (int j = 0; j < n; ++j)
+                    out[j] = static_cast<T>(table.box(r, r + 1, begin, k1, j, j + 1) / count);
+                break;
+            case ProjectionAxis::X:         // Salida (i, k)
+                for (int k = 0; k < n; ++k)
+                    out[k] = static_cast<T>(table.box(k, k + 1, r, r + 1, begin, k1) / count);
+                break;
+            }
+        }
+    });
+}
+
+template <typename T>
+void buildRangeFor(const PixelBuffer& volume, ProjectionAxis axis, ProjectionCriterion criterion,
+                   VolumeIndex::RangeTable& table, ThreadPool& pool) {
+    if (criterion == ProjectionCriterion::Max) buildRangeTable<T, MaxPick<T> >(volume, axis, table, pool);
+    else buildRangeTable<T, MinPick<T> >(volume, axis, table, pool);
+}
+
+template <typename T>
+void queryRangeFor(const PixelBuffer& volume, ProjectionAxis axis, ProjectionCriterion criterion,
+                   const VolumeIndex::RangeTable& table, int begin, int end, PixelBuffer& result,
+                   ThreadPool& pool) {
+    if (criterion == ProjectionCriterion::Max)
+        queryRangeTable<T, MaxPick<T> >(volume, axis, table, begin, end, result, pool);
+    else
+        queryRangeTable<T, MinPick<T> >(volume, axis, table, begin, end, result, pool);
+}
+
+}  // namespace
+
+VolumeIndex::VolumeIndex() : width_(0), height_(0), depth_(0), maxValue_(0) {}
+
+VolumeIndex::~VolumeIndex() {}
+
+void VolumeIndex::clear() {
+    width_ = height_ = depth_ = maxValue_ = 0;
+    std::vector<uint32_t>().swap(sums32_);
+    std::vector<uint64_t>().swap(sums64_);
+    for (int a = 0; a < 3; ++a)
+        for (int c = 0; c < 2; ++c) ranges_[a][c].reset();
+}
+
+void VolumeIndex::swap(VolumeIndex& other) {
+    std::swap(width_, other.width_);
+    std::swap(height_, other.height_);
+    std::swap(depth_, other.depth_);
+    std::swap(maxValue_, other.maxValue_);
+    sums32_.swap(other.sums32_);
+    sums64_.swap(other.sums64_);
+    for (int a = 0; a < 3; ++a)
+        for (int c = 0; c < 2; ++c) ranges_[a][c].swap(other.ranges_[a][c]);
+}
+
+size_t VolumeIndex::sizeInBytes() const {
+    size_t total = sums32_.size() * sizeof(uint32_t) + sums64_.size() * sizeof(uint64_t);
+    for (int a = 0; a < 3; ++a)
+        for (int c = 0; c < 2; ++c)
+            if (ranges_[a][c]) total += ranges_[a][c]->sizeInBytes();
+    return total;
+}
+
+void VolumeIndex::reset(const PixelBuffer& volume) {
+    if (volume.width() == width_ && volume.height() == height_ && volume.depth() == depth_ &&
+        volume.maxValue() == maxValue_)
+        return;
+    clear();
+    width_ = volume.width();
+    height_ = volume.height();
+    depth_ = volume.depth();
+    maxValue_ = volume.maxValue();
+}
+
+void VolumeIndex::buildSums(const PixelBuffer& volume, ThreadPool& pool) {
+    reset(volume);
+    // 32 bits alcanzan si la suma de todo el volumen entra en ellos
+    const uint64_t voxels = static_cast<uint64_t>(width_) * height_ * depth_;
+    if (static_cast<uint64_t>(maxValue_) * voxels <= std::numeric_limits<uint32_t>::max()) {
+        std::vector<uint64_t>().swap(sums64_);
+        if (volume.wide()) buildSumTable<uint16_t>(volume, sums32_, pool);
+        else buildSumTable<uint8_t>(volume, sums32_, pool);
+    } else {
+        std::vector<uint32_t>().swap(sums32_);
+        if (volume.wide()) buildSumTable<uint16_t>(volume, sums64_, pool);
+        else buildSumTable<uint8_t>(volume, sums64_, pool);
+    }
+}
+
+void VolumeIndex::buildRange(const PixelBuffer& volume, ProjectionAxis axis, ProjectionCriterion criterion,
+                             ThreadPool& pool) {
+    reset(volume);
+    std::unique_ptr<RangeTable>& slot = ranges_[axisSlot(axis)][criterion == ProjectionCriterion::Max ? 0 : 1];
+    slot.reset(new RangeTable());
+    slot->shape = shapeOf(width_, height_, depth_, axis);
+    if (volume.wide()) buildRangeFor<uint16_t>(volume, axis, criterion, *slot, pool);
+    else buildRangeFor<uint8_t>(volume, axis, criterion, *slot, pool);
+}
+
+bool VolumeIndex::hasSums() const {
+    return !sums32_.empty() || !sums64_.empty();
+}
+
+bool VolumeIndex::hasRange(ProjectionAxis axis, ProjectionCriterion criterion) const {
+    if (criterion != ProjectionCriterion::Max && criterion != ProjectionCriterion::Min) return false;
+    return ranges_[axisSlot(axis)][criterion == ProjectionCriterion::Max ? 0 : 1] != nullptr;
+}
+
+void VolumeIndex::projectSlab(const PixelBuffer& volume, ProjectionAxis axis, ProjectionCriterion criterion,
+                              int begin, int end, PixelBuffer& result, ThreadPool& pool) const {
+    const AxisShape shape = shapeOf(width_, height_, depth_, axis);
+    result.allocate(shape.rowLength, shape.planeRows, 1, maxValue_);
+
+    if (criterion == ProjectionCriterion::Mean) {
+        const bool wide = volume.wide();
+        if (!sums32_.empty()) {
+            if (wide) querySumTable<uint16_t>(sums32_, width_, height_, axis, begin, end, result, pool);
+            else querySumTable<uint8_t>(sums32_, width_, height_, axis, begin, end, result, pool);
+        } else {
+            if (wide) querySumTable<uint16_t>(sums64_, width_, height_, axis, begin, end, result, pool);
+            else querySumTable<uint8_t>(sums64_, width_, height_, axis, begin, end, result, pool);
+        }
+        return;
+    }
+
+    const RangeTable& table = *ranges_[axisSlot(axis)][criterion == ProjectionCriterion::Max ? 0 : 1];
+    if (volume.wide()) queryRangeFor<uint16_t>(volume, axis, criterion, table, begin, end, result, pool);
+    else queryRangeFor<uint8_t>(volume, axis, criterion, table, begin, end, result, pool);
+}
+
+uint64_t VolumeIndex::boxSum(int x0, int x1, int y0, int y1, int z0, int z1) const {
+    const size_t rowStride = static_cast<size_t>(width_) + 1, sliceStride = rowStride * (height_ + 1);
+    if (!sums32_.empty()) {
+        const SumTable<uint32_t> table = { sums32_.data(), rowStride, sliceStride };
+        return table.box(z0, z1 + 1, y0, y1 + 1, x0, x1 + 1);
+    }
+    const SumTable<uint64_t> table = { sums64_.data(), rowStride, sliceStride };
+    return table.box(z0, z1 + 1, y0, y1 + 1, x0, x1 + 1);
+}
+
+void copySlab(const PixelBuffer& volume, ProjectionAxis axis, int begin, int end, PixelBuffer& slab) {
+    const int count = end - begin + 1;
+    int width = volume.width(), height = volume.height(), depth = volume.depth();
+    int k0 = 0, i0 = 0, j0 = 0;
+    switch (axis) {
+    case ProjectionAxis::Z: depth = count; k0 = begin; break;
+    case ProjectionAxis::Y: height = count; i0 = begin; break;
+    case ProjectionAxis::X: width = count; j0 = begin; break;
+    }
+    slab.allocate(width, height, depth, volume.maxValue());
+    const size_t rowBytes = static_cast<size_t>(width) * volume.bytesPerPixel();
+    for (int k = 0; k < depth; ++k)
+        for (int i = 0; i < height; ++i)
+            std::memcpy(slab.data() + (k * slab.sliceStride() + i * slab.rowStride()) * slab.bytesPerPixel(),
+                        volume.data() + ((k0 + k) * volume.sliceStride() + (i0 + i) * volume.rowStride() + j0) *
+                                            volume.bytesPerPixel(),
+                        rowBytes);
+}
@@ -0,0 +1,79 @@
+#ifndef INDICE_VOLUMEN_H
+#define INDICE_VOLUMEN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "imagen.h"
+#include "pool_hilos.h"
+#include "proyeccion.h"
+
+// ————————————
+// Índice precalculado sobre el volumen cargado para proyecciones de una
+// losa (un rango de cortes, filas o columnas) y sumas de regiones.
+//
+// Promedio: tabla de sumas 3D (summed-volume) de (P+1)x(A+1)x(L+1)
+// entradas, S[k][i][j] = suma de los vóxeles con k' < k, i' < i, j' < j.
+// La suma de cualquier caja sale de 8 entradas, así que la losa cuesta
+// O(1) por píxel de salida y sirve para las tres direcciones. Las entradas
+// son de 32 bits si M x vóxeles entra en 32 bits, y de 64 si no.
+//
+// Máximo y mínimo: por dirección, bloques de 16 posiciones a lo largo del
+// eje con el máximo (o mínimo) acumulado desde el inicio y hasta
+// el final de cada bloque, más una tabla dispersa sobre los bloques
+// enteros. Un rango que cruza bloques se responde con un sufijo, un prefijo
+// y dos entradas de la tabla dispersa (O(1)); uno dentro de un bloque
+// recorre a lo sumo 16 posiciones del volumen. Ocupa poco más de dos veces
+// el volumen por dirección y criterio.
+//
+// Las tablas se guardan con el eje como dimensión exterior, de modo que
+// una losa se resuelve con operaciones sobre planos completos. Los
+// resultados son idénticos a los de projectVolume sobre la misma losa.
+//————————————
+class VolumeIndex {
+public:
+    VolumeIndex();
+    ~VolumeIndex();
+
+    void clear();
+    void swap(VolumeIndex& other);              // Intercambia las tablas sin copiarlas
+    size_t sizeInBytes() const;
+
+    // Construyen las tablas de volume; las anteriores se descartan si el
+    // volumen cambió de tamaño.
+    void buildSums(const PixelBuffer& volume, ThreadPool& pool);
+    void buildRange(const PixelBuffer& volume, ProjectionAxis axis, ProjectionCriterion criterion,
+                    ThreadPool& pool);     // criterion: Max o Min
+    bool hasSums() const;
+    bool hasRange(ProjectionAxis axis, ProjectionCriterion criterion) const;
+
+    // Proyección de la losa [begin, end] (inclusive, desde 0) a lo largo de
+    // axis con Max, Min o Mean; la tabla correspondiente debe existir y
+    // volume debe ser el volumen indexado. Mismas dimensiones de salida que
+    // projectVolume sobre la losa.
+    void projectSlab(const PixelBuffer& volume, ProjectionAxis axis, ProjectionCriterion criterion,
+                     int begin, int end, PixelBuffer& result, ThreadPool& pool) const;
+
+    // Suma de la caja [x0, x1] x [y0, y1] x [z0, z1] (inclusive); requiere hasSums().
+    uint64_t boxSum(int x0, int x1, int y0, int y1, int z0, int z1) const;
+
+    struct RangeTable;
+
+private:
+    VolumeIndex(const VolumeIndex&);             // No copiable
+    VolumeIndex& operator=(const VolumeIndex&);
+
+    void reset(const PixelBuffer& volume);       // Descarta todo si cambió el volumen
+
+    int width_, height_, depth_, maxValue_;
+    std::vector<uint32_t> sums32_;               // Una de las dos, según el tamaño
+    std::vector<uint64_t> sums64_;
+    std::unique_ptr<RangeTable> ranges_[3][2];   // [eje][0 = Max, 1 = Min]; vacío = sin construir
+};
+
+// Copia en slab los cortes (z), filas (y) o columnas (x) [begin, end] de
+// volume, para los criterios que no tienen índice (la mediana).
+void copySlab(const PixelBuffer& volume, ProjectionAxis axis, int begin, int end, PixelBuffer& slab);
+
+#endif
@@ -0,0 +1,98 @@
+#include "lector_cortes.h"
+
+#include <cstring>
+#include "archivo_mapeado.h"
+#include "perfil.h"
+
+SliceReader::SliceReader() : current_(nullptr), delivered_(0), stopping_(false), profile_(nullptr) {}
+
+SliceReader::~SliceReader() {
+    stop();
+}
+
+void SliceReader::start(const std::vector<std::string>& files, const std::vector<PgmHeader>& headers,
+                        int width, int height, int maxValue, int ahead) {
+    stop();
+    files_ = files;
+    headers_ = headers;
+    buffers_.assign(ahead + 1, PixelBuffer());
+    free_.clear();
+    ready_.clear();
+    for (size_t b = 0; b < buffers_.size(); ++b) {
+        buffers_[b].allocate(width, height, 1, maxValue);
+        free_.push_back(&buffers_[b]);
+    }
+    current_ = nullptr;
+    delivered_ = 0;
+    stopping_ = false;
+    profile_ = sessionProfile();
+    thread_ = std::thread(&SliceReader::readLoop, this);
+}
+
+void SliceReader::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+const PixelBuffer* SliceReader::next(PgmStatus& status) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (current_) {                               // El corte anterior ya no se usa
+        free_.push_back(current_);
+        current_ = nullptr;
+        changed_.notify_all();
+    }
+    if (delivered_ == files_.size()) return nullptr;
+
+    changed_.wait(lock, [&] { return !ready_.empty(); });
+    current_ = ready_.front().slice;
+    status = ready_.front().status;
+    ready_.pop_front();
+    ++delivered_;
+    return current_;
+}
+
+void SliceReader::readLoop() {
+    ProfileScope scope(profile_);
+    for (size_t k = 0; k < files_.size(); ++k) {
+        PixelBuffer* slice;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [&] { return stopping_ || !free_.empty(); });
+            if (stopping_) return;
+            slice = free_.front();
+            free_.pop_front();
+        }
+
+        // Un corte más chico que el volumen deja el resto en cero
+        const PgmHeader& expected = headers_[k];
+        if (expected.width != slice->width() || expected.height != slice->height())
+            std::memset(slice->data(), 0, slice->sizeInBytes());
+
+        // El archivo se vuelve a abrir: si cambió desde el escaneo de cabeceras,
+        // el corte se rechaza en vez de leerse con desplazamientos obsoletos
+        PhaseTimer timer(Phase::PixelParse);
+        MappedFile file;
+        PgmStatus status = file.open(files_[k]) ? PgmStatus::Ok : PgmStatus::OpenError;
+        if (status == PgmStatus::Ok) {
+            recordBytesRead(file.size());
+            PgmHeader header;
+            status = parsePGMHeader(file.data(), file.size(), header);
+            if (status == PgmStatus::Ok &&
+                (header.width != expected.width || header.height != expected.height ||
+                 header.maxValue != expected.maxValue || header.binary != expected.binary))
+                status = PgmStatus::CorruptData;
+            if (status == PgmStatus::Ok)
+                status = parsePGMPixels(file.data(), file.size(), header, *slice, 0);
+        }
+        timer.stop();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Ready item = { slice, status };
+        ready_.push_back(item);
+        changed_.notify_all();
+    }
+}
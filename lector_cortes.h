@@ -0,0 +1,65 @@
+#ifndef LECTOR_CORTES_H
+#define LECTOR_CORTES_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "imagen.h"
+#include "perfil.h"
+#include "pgm.h"
+
+// ————————————
+// Lectura anticipada de cortes PGM.
+//
+// Un hilo propio lee y decodifica los archivos en orden, cada uno en un
+// buffer de width x height (los cortes más chicos quedan rellenos con
+// ceros, igual que en cargar_volumen), y se adelanta hasta ahead cortes
+// mientras quien llama procesa el actual. Solo existen ahead + 1 buffers,
+// así que la memoria no depende de la cantidad de cortes. Lo que mide el
+// hilo lector se suma a la sesión de quien llamó a start (ver perfil.h).
+//————————————
+class SliceReader {
+public:
+    SliceReader();
+    ~SliceReader();                     // Detiene la lectura pendiente
+
+    // Empieza a leer files; headers son sus cabeceras ya interpretadas.
+    void start(const std::vector<std::string>& files, const std::vector<PgmHeader>& headers,
+               int width, int height, int maxValue, int ahead);
+
+    // Siguiente corte en orden, válido hasta la próxima llamada; nullptr
+    // cuando ya se entregaron todos. status recibe el resultado de su lectura.
+    const PixelBuffer* next(PgmStatus& status);
+
+    void stop();
+
+private:
+    SliceReader(const SliceReader&);              // No copiable
+    SliceReader& operator=(const SliceReader&);
+
+    struct Ready {
+        PixelBuffer* slice;
+        PgmStatus status;
+    };
+
+    void readLoop();
+
+    std::vector<std::string> files_;
+    std::vector<PgmHeader> headers_;
+    std::vector<PixelBuffer> buffers_;
+    std::deque<PixelBuffer*> free_;     // Buffers disponibles para el hilo lector
+    std::deque<Ready> ready_;           // Cortes leídos, en orden
+    PixelBuffer* current_;              // Corte entregado en la última llamada a next
+    size_t delivered_;
+    bool stopping_;
+    ProfileCounters* profile_;          // Sesión de quien llamó a start
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::thread thread_;
+};
+
+#endif
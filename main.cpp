@@ -1,7 +1,132 @@
 #include "sistema.h"
 
-int main() {
+/**
+ * Sin argumentos se abre la consola interactiva. Modo por lotes:
+ *
+ *     programa --lote <script.txt | -> [--continuar]
+ *     programa -c "<comando>" [-c "<comando>" ...] [--continuar]
+ *
+ * Por defecto se detiene en el primer comando que falla; con --continuar
+ * ejecuta todos. El código de salida es 0 si todo salió bien, 1 si algún
+ * comando falló y 2 si los argumentos no son válidos.
+ *
+ * Modo servidor, con las imágenes y los volúmenes cargados residentes
+ * entre pedidos:
+ *
+ *     programa --servidor <ruta.sock>
+ *     programa --conectar <ruta.sock> --lote <script.txt | -> [--continuar]
+ *     programa --conectar <ruta.sock> -c "<comando>" ... [--continuar]
+ *
+ * El servidor atiende a varios clientes a la vez hasta recibir SIGINT o
+ * SIGTERM. Cada cliente manda sus comandos por el socket y recibe la misma
+ * salida que en el modo por lotes; el estado (imágenes, volúmenes,
+ * configuración) es compartido entre todos. --conectar devuelve los mismos
+ * códigos de salida que el modo por lotes, y 2 si no se pudo conectar.
+ */
+namespace {
+
+const unsigned kMaxClients = 64;
+
+// Mensaje de error de una operación del servidor o del cliente.
+void reportServerStatus(ServerStatus status, const string& path) {
+    switch (status) {
+    case ServerStatus::Ok:
+        break;
+    case ServerStatus::PathTooLong:
+        cerr << "Error: La ruta del socket es demasiado larga: " << path << endl;
+        break;
+    case ServerStatus::InUse:
+        cerr << "Error: Ya hay un servidor escuchando en " << path << endl;
+        break;
+    case ServerStatus::SocketError:
+        cerr << "Error: No se pudo usar el socket " << path << endl;
+        break;
+    case ServerStatus::Disconnected:
+        cerr << "Error: El servidor cerró la conexión." << endl;
+        break;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
     ImageProcessingSystem system;
-    system.start();
-    return 0;
+    if (argc == 1) {
+        system.start();
+        return 0;
+    }
+
+    string scriptName, serverPath, connectPath;
+    stringstream commands;
+    bool inlineCommands = false, stopOnError = true;
+    for (int a = 1; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg == "--lote" && a + 1 < argc && scriptName.empty()) {
+            scriptName = argv[++a];
+        } else if (arg == "-c" && a + 1 < argc) {
+            commands << argv[++a] << '\n';
+            inlineCommands = true;
+        } else if (arg == "--continuar") {
+            stopOnError = false;
+        } else if (arg == "--servidor" && a + 1 < argc && serverPath.empty()) {
+            serverPath = argv[++a];
+        } else if (arg == "--conectar" && a + 1 < argc && connectPath.empty()) {
+            connectPath = argv[++a];
+        } else {
+            cerr << "Uso: programa [--lote <script.txt|-> | -c \"<comando>\" ...] [--continuar]\n"
+                 << "     programa --servidor <ruta.sock>\n"
+                 << "     programa --conectar <ruta.sock> [--lote <script.txt|-> | -c \"<comando>\" ...] [--continuar]"
+                 << endl;
+            return 2;
+        }
+    }
+
+    // Servidor: atiende conexiones hasta SIGINT o SIGTERM
+    if (!serverPath.empty()) {
+        if (!connectPath.empty() || !scriptName.empty() || inlineCommands || !stopOnError) {
+            cerr << "Error: --servidor no se combina con otras opciones." << endl;
+            return 2;
+        }
+        UnixSocketServer server;
+        ServerStatus status = server.open(serverPath);
+        if (status != ServerStatus::Ok) {
+            reportServerStatus(status, serverPath);
+            return 2;
+        }
+        cerr << "Servidor escuchando en " << serverPath << endl;
+        server.run(kMaxClients, [&system](istream& in, ostream& out) { system.serveSession(in, out); });
+        cerr << "Servidor detenido." << endl;
+        return 0;
+    }
+
+    if (scriptName.empty() == !inlineCommands) {
+        cerr << "Error: Use --lote o -c, pero no ambos." << endl;
+        return 2;
+    }
+
+    // La salida queda en el buffer de cout y se escribe en bloques grandes
+    ios::sync_with_stdio(false);
+    ifstream scriptFile;
+    if (!inlineCommands && scriptName != "-") {
+        scriptFile.open(scriptName);
+        if (!scriptFile) {
+            cerr << "Error: No se pudo abrir el script " << scriptName << endl;
+            return 2;
+        }
+    }
+    if (scriptName == "-") cin.tie(nullptr);
+    istream& script = inlineCommands ? static_cast<istream&>(commands)
+                    : scriptName == "-" ? cin : static_cast<istream&>(scriptFile);
+
+    // Cliente: los comandos corren en el servidor
+    if (!connectPath.empty()) {
+        int failures = 0;
+        ServerStatus status = runSocketClient(connectPath, script, stopOnError, cout, failures);
+        if (status != ServerStatus::Ok) {
+            reportServerStatus(status, connectPath);
+            return 2;
+        }
+        return failures == 0 ? 0 : 1;
+    }
+    return system.runBatch(script, stopOnError);
 }
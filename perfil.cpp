@@ -0,0 +1,111 @@
+#include "perfil.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+ProfileCounters processCounters;                        // Todo el proceso
+thread_local ProfileCounters* currentSession = nullptr; // Ver ProfileScope
+
+const char* const kPhaseNames[kPhaseCount] = {
+    "lectura de cabeceras",
+    "decodificación de píxeles",
+    "relleno del volumen",
+    "caché de volumen",
+    "núcleo de proyección",
+    "modelo de Huffman",
+    "empaquetado de bits",
+    "decodificación Huffman",
+    "segmentación",
+    "construcción de índices",
+    "escritura de archivos"
+};
+
+void add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+ProfileCounters::ProfileCounters() {
+    resetProfile(*this);
+}
+
+const char* phaseName(Phase phase) {
+    return kPhaseNames[static_cast<int>(phase)];
+}
+
+void recordPhase(Phase phase, uint64_t ns) {
+    const int p = static_cast<int>(phase);
+    add(processCounters.calls[p], 1);
+    add(processCounters.nanoseconds[p], ns);
+    if (currentSession) {
+        add(currentSession->calls[p], 1);
+        add(currentSession->nanoseconds[p], ns);
+    }
+}
+
+void recordBytesRead(uint64_t bytes) {
+    add(processCounters.bytesRead, bytes);
+    if (currentSession) add(currentSession->bytesRead, bytes);
+}
+
+void recordBytesWritten(uint64_t bytes) {
+    add(processCounters.bytesWritten, bytes);
+    if (currentSession) add(currentSession->bytesWritten, bytes);
+}
+
+ProfileSnapshot profileSnapshot() {
+    return profileSnapshot(processCounters);
+}
+
+ProfileSnapshot profileSnapshot(const ProfileCounters& counters) {
+    ProfileSnapshot s;
+    for (int p = 0; p < kPhaseCount; ++p) {
+        s.calls[p] = counters.calls[p].load(std::memory_order_relaxed);
+        s.nanoseconds[p] = counters.nanoseconds[p].load(std::memory_order_relaxed);
+    }
+    s.bytesRead = counters.bytesRead.load(std::memory_order_relaxed);
+    s.bytesWritten = counters.bytesWritten.load(std::memory_order_relaxed);
+    return s;
+}
+
+void resetProfile() {
+    resetProfile(processCounters);
+}
+
+void resetProfile(ProfileCounters& counters) {
+    for (int p = 0; p < kPhaseCount; ++p) {
+        counters.calls[p].store(0, std::memory_order_relaxed);
+        counters.nanoseconds[p].store(0, std::memory_order_relaxed);
+    }
+    counters.bytesRead.store(0, std::memory_order_relaxed);
+    counters.bytesWritten.store(0, std::memory_order_relaxed);
+}
+
+ProfileCounters* sessionProfile() {
+    return currentSession;
+}
+
+ProfileScope::ProfileScope(ProfileCounters* counters) : previous_(currentSession) {
+    currentSession = counters;
+}
+
+ProfileScope::~ProfileScope() {
+    currentSession = previous_;
+}
+
+bool residentMemory(size_t& current, size_t& peak) {
+    FILE* status = std::fopen("/proc/self/status", "r");
+    if (!status) return false;
+    char line[256];
+    int found = 0;
+    unsigned long kb;
+    while (found < 2 && std::fgets(line, sizeof(line), status)) {
+        if (std::sscanf(line, "VmRSS: %lu kB", &kb) == 1) { current = kb * 1024; ++found; }
+        else if (std::sscanf(line, "VmHWM: %lu kB", &kb) == 1) { peak = kb * 1024; ++found; }
+    }
+    std::fclose(status);
+    return found == 2;
+}
@@ -0,0 +1,111 @@
+#ifndef PERFIL_H
+#define PERFIL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// ————————————
+// Medición por fases de los comandos.
+//
+// Cada fase acumula la cantidad de veces que corrió y su tiempo de reloj
+// total en contadores atómicos globales, junto con los bytes leídos y
+// escritos. Las fases son gruesas (una por archivo o por llamada a un
+// núcleo), así que medirlas cuesta dos lecturas del reloj y dos sumas
+// atómicas: nada frente al trabajo que miden. Fases que corren en hilos
+// distintos al mismo tiempo (por ejemplo la lectura anticipada de cortes)
+// pueden sumar más que el tiempo total del comando.
+//
+// En el modo servidor cada conexión lleva además sus propios contadores:
+// mientras un ProfileScope está activo en un hilo, lo que ese hilo mide se
+// suma también a los de la sesión. Los hilos que trabajan para otro (el
+// pool, la lectura anticipada, la escritura diferida) toman la sesión del
+// hilo que les dio el trabajo.
+//————————————
+enum class Phase {
+    HeaderScan,         // Lectura de cabeceras PGM
+    PixelParse,         // Decodificación de los píxeles
+    Padding,            // Reserva del volumen relleno con ceros
+    CacheLoad,          // Validación y proyección de la caché de volumen
+    Projection,         // Núcleos de proyección
+    HuffmanModel,       // Frecuencias y longitudes del código
+    BitPacking,         // Codificación de los bloques
+    HuffmanDecode,      // Verificación y decodificación de los bloques
+    Segmentation,       // Crecimiento de regiones
+    IndexBuild,         // Construcción de los índices del volumen
+    FileWrite,          // Escritura de archivos
+    Count
+};
+
+const int kPhaseCount = static_cast<int>(Phase::Count);
+
+struct ProfileSnapshot {
+    uint64_t calls[kPhaseCount];
+    uint64_t nanoseconds[kPhaseCount];
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+};
+
+struct ProfileCounters {
+    std::atomic<uint64_t> calls[kPhaseCount];
+    std::atomic<uint64_t> nanoseconds[kPhaseCount];
+    std::atomic<uint64_t> bytesRead;
+    std::atomic<uint64_t> bytesWritten;
+
+    ProfileCounters();                  // En cero
+};
+
+const char* phaseName(Phase phase);
+
+void recordPhase(Phase phase, uint64_t nanoseconds);
+void recordBytesRead(uint64_t bytes);
+void recordBytesWritten(uint64_t bytes);
+
+ProfileSnapshot profileSnapshot();                                  // Todo el proceso
+ProfileSnapshot profileSnapshot(const ProfileCounters& counters);
+void resetProfile();
+void resetProfile(ProfileCounters& counters);
+
+// Contadores de la sesión del hilo actual; nullptr fuera de una sesión.
+ProfileCounters* sessionProfile();
+
+// Hace de counters la sesión del hilo mientras existe (nullptr: ninguna).
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileCounters* counters);
+    ~ProfileScope();
+
+private:
+    ProfileScope(const ProfileScope&);              // No copiable
+    ProfileScope& operator=(const ProfileScope&);
+
+    ProfileCounters* previous_;
+};
+
+// Memoria residente del proceso y su pico (VmRSS y VmHWM); false si no se pudo leer.
+bool residentMemory(size_t& current, size_t& peak);
+
+// Mide el tiempo desde su creación hasta stop() o su destrucción.
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Phase phase) : phase_(phase), running_(true), start_(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() { stop(); }
+
+    void stop() {
+        if (!running_) return;
+        running_ = false;
+        std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start_;
+        recordPhase(phase_, static_cast<uint64_t>(elapsed.count()));
+    }
+
+private:
+    PhaseTimer(const PhaseTimer&);              // No copiable
+    PhaseTimer& operator=(const PhaseTimer&);
+
+    Phase phase_;
+    bool running_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif
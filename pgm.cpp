@@ -0,0 +1,332 @@
+#include "pgm.h"
+#include "archivo_mapeado.h"
+#include "perfil.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <utility>
+
+namespace {
+
+inline bool isSpace(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Salta espacios y comentarios de la cabecera. Devuelve la nueva posición.
+size_t skipHeaderSpace(const char* data, size_t size, size_t pos) {
+    while (pos < size) {
+        unsigned char c = data[pos];
+        if (isSpace(c)) {
+            ++pos;
+        } else if (c == '#') {
+            while (pos < size && data[pos] != '\n') ++pos;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+// Lee un entero no negativo de la cabecera; -1 si no hay dígitos o desborda.
+long readHeaderInt(const char* data, size_t size, size_t& pos) {
+    pos = skipHeaderSpace(data, size, pos);
+    size_t start = pos;
+    long value = 0;
+    while (pos < size && static_cast<unsigned>(data[pos] - '0') <= 9) {
+        value = value * 10 + (data[pos] - '0');
+        if (value > 0x7fffffffL) return -1;
+        ++pos;
+    }
+    if (pos == start) return -1;
+    if (pos < size && !isSpace(data[pos]) && data[pos] != '#') return -1;
+    return value;
+}
+
+// Bucle crítico: recorre los enteros en texto y los escribe fila por fila.
+template <typename T>
+PgmStatus scanPixels(const char* p, const char* end, const PgmHeader& header,
+                     PixelBuffer& dst, int k) {
+    const unsigned maxValue = static_cast<unsigned>(header.maxValue);
+    for (int i = 0; i < header.height; ++i) {
+        T* row = dst.row<T>(k, i);
+        for (int j = 0; j < header.width; ++j) {
+            while (p < end && isSpace(*p)) ++p;
+
+            if (p >= end) return PgmStatus::CorruptData;                // Datos truncados
+            unsigned value = static_cast<unsigned char>(*p) - '0';
+            if (value > 9) return PgmStatus::CorruptData;               // No numérico
+            ++p;
+
+            unsigned digit;
+            while (p < end && (digit = static_cast<unsigned char>(*p) - '0') <= 9) {
+                value = value * 10 + digit;
+                if (value > maxValue) return PgmStatus::CorruptData;
+                ++p;
+            }
+            if (value > maxValue || (p < end && !isSpace(*p))) return PgmStatus::CorruptData;
+
+            row[j] = static_cast<T>(value);
+        }
+    }
+    return PgmStatus::Ok;
+}
+
+// Copia píxeles P5 (8 bits, o 16 bits big-endian) al corte k, validando el rango.
+template <typename T>
+PgmStatus copyBinaryPixels(const unsigned char* src, const PgmHeader& header,
+                           PixelBuffer& dst, int k) {
+    const unsigned maxValue = static_cast<unsigned>(header.maxValue);
+    const bool wideSource = header.maxValue > 255;
+    for (int i = 0; i < header.height; ++i) {
+        T* row = dst.row<T>(k, i);
+        unsigned rowMax = 0;
+        if (wideSource) {
+            for (int j = 0; j < header.width; ++j, src += 2) {
+                unsigned value = (static_cast<unsigned>(src[0]) << 8) | src[1];
+                rowMax = value > rowMax ? value : rowMax;
+                row[j] = static_cast<T>(value);
+            }
+        } else {
+            for (int j = 0; j < header.width; ++j) {
+                unsigned value = src[j];
+                rowMax = value > rowMax ? value : rowMax;
+                row[j] = static_cast<T>(value);
+            }
+            src += header.width;
+        }
+        if (rowMax > maxValue) return PgmStatus::CorruptData;
+    }
+    return PgmStatus::Ok;
+}
+
+// true si ningún byte supera maxValue (solo hace falta cuando M < 255).
+bool bytesInRange(const unsigned char* src, size_t count, unsigned maxValue) {
+    if (maxValue >= 255) return true;
+    unsigned char top = 0;
+    for (size_t i = 0; i < count; ++i) top = src[i] > top ? src[i] : top;
+    return top <= maxValue;
+}
+
+size_t binaryDataSize(const PgmHeader& header) {
+    return static_cast<size_t>(header.width) * header.height * (header.maxValue > 255 ? 2 : 1);
+}
+
+}  // namespace
+
+PgmStatus parsePGMHeader(const char* data, size_t size, PgmHeader& header) {
+    size_t pos = skipHeaderSpace(data, size, 0);
+    if (size - pos < 2 || data[pos] != 'P' || (data[pos + 1] != '2' && data[pos + 1] != '5') ||
+        (pos + 2 < size && !isSpace(data[pos + 2]) && data[pos + 2] != '#'))
+        return PgmStatus::BadFormat;
+    header.binary = data[pos + 1] == '5';
+    pos += 2;
+
+    long width = readHeaderInt(data, size, pos);
+    long height = readHeaderInt(data, size, pos);
+    long maxValue = readHeaderInt(data, size, pos);
+    if (width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 65535)
+        return PgmStatus::BadHeader;
+
+    header.width = static_cast<int>(width);
+    header.height = static_cast<int>(height);
+    header.maxValue = static_cast<int>(maxValue);
+    header.dataOffset = pos;
+    if (header.binary) {
+        // En P5 los datos empiezan justo después de un único espacio
+        if (pos >= size || !isSpace(data[pos])) return PgmStatus::BadHeader;
+        header.dataOffset = pos + 1;
+    }
+    return PgmStatus::Ok;
+}
+
+PgmStatus parsePGMPixels(const char* data, size_t size, const PgmHeader& header,
+                         PixelBuffer& dst, int k) {
+    if (header.dataOffset > size) return PgmStatus::CorruptData;   // Cabecera de otro archivo
+    if (header.binary) {
+        if (size - header.dataOffset < binaryDataSize(header)) return PgmStatus::CorruptData;
+        const unsigned char* src = reinterpret_cast<const unsigned char*>(data) + header.dataOffset;
+        if (dst.wide()) return copyBinaryPixels<uint16_t>(src, header, dst, k);
+        return copyBinaryPixels<uint8_t>(src, header, dst, k);
+    }
+
+    const char* p = data + header.dataOffset;
+    const char* end = data + size;
+    if (dst.wide()) return scanPixels<uint16_t>(p, end, header, dst, k);
+    return scanPixels<uint8_t>(p, end, header, dst, k);
+}
+
+PgmStatus readPGMFile(const std::string& filename, PixelBuffer& image, size_t* bytesRead) {
+    PhaseTimer headerTimer(Phase::HeaderScan);
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(filename)) return PgmStatus::OpenError;
+    if (bytesRead) *bytesRead = file->size();
+    recordBytesRead(file->size());
+
+    PgmHeader header;
+    PgmStatus status = parsePGMHeader(file->data(), file->size(), header);
+    if (status != PgmStatus::Ok) return status;
+    headerTimer.stop();
+    PhaseTimer parseTimer(Phase::PixelParse);
+
+    // P5 de 8 bits: la imagen apunta directamente a la proyección del archivo
+    if (header.binary && header.maxValue <= 255) {
+        size_t count = binaryDataSize(header);
+        if (file->size() - header.dataOffset < count) return PgmStatus::CorruptData;
+        unsigned char* pixels = reinterpret_cast<unsigned char*>(file->data()) + header.dataOffset;
+        if (!bytesInRange(pixels, count, static_cast<unsigned>(header.maxValue)))
+            return PgmStatus::CorruptData;
+        image.wrap(header.width, header.height, 1, header.maxValue, header.width, pixels, file);
+        return PgmStatus::Ok;
+    }
+
+    PixelBuffer pixels;
+    pixels.allocate(header.width, header.height, 1, header.maxValue);
+    status = parsePGMPixels(file->data(), file->size(), header, pixels, 0);
+    if (status != PgmStatus::Ok) return status;
+
+    std::swap(image, pixels);
+    return PgmStatus::Ok;
+}
+
+namespace {
+
+const size_t kWriteBlock = 1 << 20;     // Bytes por escritura al archivo
+
+// ————————————
+// Escritura de enteros con una tabla de pares de dígitos ("00".."99"):
+// se generan dos dígitos por división, de derecha a izquierda.
+//————————————
+struct DigitPairs {
+    char digits[200];
+    DigitPairs() {
+        for (int n = 0; n < 100; ++n) {
+            digits[2 * n] = static_cast<char>('0' + n / 10);
+            digits[2 * n + 1] = static_cast<char>('0' + n % 10);
+        }
+    }
+};
+
+// Escribe value en p y devuelve la posición siguiente al último dígito.
+inline char* formatUnsigned(char* p, unsigned value) {
+    static const DigitPairs table;
+    char temp[10];
+    char* end = temp + sizeof(temp);
+    char* q = end;
+    while (value >= 100) {
+        unsigned pair = (value % 100) * 2;
+        value /= 100;
+        *--q = table.digits[pair + 1];
+        *--q = table.digits[pair];
+    }
+    if (value >= 10) {
+        *--q = table.digits[value * 2 + 1];
+        *--q = table.digits[value * 2];
+    } else {
+        *--q = static_cast<char>('0' + value);
+    }
+    while (q < end) *p++ = *q++;
+    return p;
+}
+
+std::string headerText(const PixelBuffer& image, PgmFormat format, const std::string& comment) {
+    std::string header = format == PgmFormat::Binary ? "P5\n" : "P2\n";
+    if (!comment.empty()) header += "# " + comment + "\n";
+    header += std::to_string(image.width()) + " " + std::to_string(image.height()) + "\n" +
+              std::to_string(image.maxValue()) + "\n";
+    return header;
+}
+
+// Cota del tamaño de una fila ya formateada.
+size_t maxRowBytes(const PixelBuffer& image, PgmFormat format) {
+    if (format == PgmFormat::Binary) return static_cast<size_t>(image.width()) * image.bytesPerPixel();
+    return static_cast<size_t>(image.width()) * 6 + 1;        // Hasta 5 dígitos y un espacio
+}
+
+// P2: cada valor seguido de un espacio y un salto de línea por fila.
+template <typename T>
+void formatAsciiRows(const PixelBuffer& image, int rowBegin, int rowEnd, std::vector<char>& out) {
+    const int width = image.width();
+    size_t used = out.size();
+    out.resize(used + (rowEnd - rowBegin) * maxRowBytes(image, PgmFormat::Ascii));
+    char* p = out.data() + used;
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        const T* row = image.row<T>(0, i);
+        for (int j = 0; j < width; ++j) {
+            p = formatUnsigned(p, row[j]);
+            *p++ = ' ';
+        }
+        *p++ = '\n';
+    }
+    out.resize(p - out.data());
+}
+
+// Agrega a out las filas [rowBegin, rowEnd) del corte 0 en el formato pedido.
+void formatRows(const PixelBuffer& image, PgmFormat format, int rowBegin, int rowEnd,
+                std::vector<char>& out) {
+    if (format == PgmFormat::Ascii) {
+        if (image.wide()) formatAsciiRows<uint16_t>(image, rowBegin, rowEnd, out);
+        else formatAsciiRows<uint8_t>(image, rowBegin, rowEnd, out);
+    } else if (!image.wide()) {
+        for (int i = rowBegin; i < rowEnd; ++i) {
+            const char* row = reinterpret_cast<const char*>(image.row<uint8_t>(0, i));
+            out.insert(out.end(), row, row + image.width());
+        }
+    } else {
+        // P5 de 16 bits se guarda en big-endian
+        for (int i = rowBegin; i < rowEnd; ++i) {
+            const uint16_t* row = image.row<uint16_t>(0, i);
+            for (int j = 0; j < image.width(); ++j) {
+                out.push_back(static_cast<char>(row[j] >> 8));
+                out.push_back(static_cast<char>(row[j] & 0xff));
+            }
+        }
+    }
+}
+
+}  // namespace
+
+void formatPGM(const PixelBuffer& image, PgmFormat format, const std::string& comment,
+               std::vector<char>& out) {
+    out.clear();
+    const std::string header = headerText(image, format, comment);
+    out.reserve(header.size() + maxRowBytes(image, format) * image.height());
+    out.insert(out.end(), header.begin(), header.end());
+    formatRows(image, format, 0, image.height(), out);
+}
+
+PgmStatus writePGMFile(const std::string& filename, const PixelBuffer& image,
+                       PgmFormat format, const std::string& comment) {
+    // Se escribe en un temporal y luego se renombra: si filename está proyectado
+    // en memoria por una imagen cargada, su contenido original sigue intacto.
+    PhaseTimer timer(Phase::FileWrite);
+    const std::string tmpName = temporaryName(filename);
+    FILE* file = std::fopen(tmpName.c_str(), "wb");
+    if (!file) return PgmStatus::WriteError;
+
+    // Filas formateadas en un buffer propio que se escribe en bloques grandes
+    std::vector<char> block;
+    const std::string header = headerText(image, format, comment);
+    block.insert(block.end(), header.begin(), header.end());
+
+    const int rowsPerBlock = static_cast<int>(std::max<size_t>(1, kWriteBlock / maxRowBytes(image, format)));
+    uint64_t written = 0;
+    bool ok = true;
+    for (int i = 0; i < image.height() && ok; i += rowsPerBlock) {
+        formatRows(image, format, i, std::min(image.height(), i + rowsPerBlock), block);
+        ok = std::fwrite(block.data(), 1, block.size(), file) == block.size();
+        written += block.size();
+        block.clear();
+    }
+    if (image.height() == 0) ok = std::fwrite(block.data(), 1, block.size(), file) == block.size();
+
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || std::rename(tmpName.c_str(), filename.c_str()) != 0) {
+        std::remove(tmpName.c_str());
+        return PgmStatus::WriteError;
+    }
+    recordBytesWritten(written);
+    return PgmStatus::Ok;
+}
@@ -0,0 +1,63 @@
+#ifndef PGM_H
+#define PGM_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "imagen.h"
+
+// ————————————
+// Lectura y escritura de archivos PGM en texto (P2) y binario (P5).
+//
+// El archivo se proyecta completo en memoria. En P2 los enteros se recorren
+// con un escáner escrito a mano, sin pasar por la extracción con formato de
+// iostream; al escribir, los enteros se formatean con una tabla de pares
+// de dígitos. En P5 de 8 bits la imagen envuelve directamente la proyección,
+// sin copiar ni convertir píxeles; en 16 bits (big-endian) se convierten al
+// orden de la máquina. Las funciones devuelven un PgmStatus; quien llama
+// decide qué mensaje mostrar.
+//————————————
+enum class PgmStatus {
+    Ok,
+    OpenError,     // No se pudo abrir el archivo
+    BadFormat,     // El número mágico no es P2 ni P5
+    BadHeader,     // Dimensiones o valor máximo ausentes o fuera de rango
+    CorruptData,   // Píxeles truncados, no numéricos o mayores que M
+    WriteError     // No se pudo crear o escribir el archivo de salida
+};
+
+enum class PgmFormat {
+    Ascii,         // P2
+    Binary         // P5
+};
+
+struct PgmHeader {
+    int width, height, maxValue;
+    bool binary;            // true para P5
+    size_t dataOffset;      // Posición del primer byte de píxeles
+};
+
+// Interpreta la cabecera P2/P5 (admite comentarios '#' entre los campos).
+PgmStatus parsePGMHeader(const char* data, size_t size, PgmHeader& header);
+
+// Decodifica los píxeles descritos por header y los escribe en el corte k de
+// dst, que ya debe estar reservado con al menos header.width x header.height.
+PgmStatus parsePGMPixels(const char* data, size_t size, const PgmHeader& header,
+                         PixelBuffer& dst, int k);
+
+// Lee un archivo completo en image. Si bytesRead no es nulo, recibe el
+// tamaño del archivo. image solo se modifica si la lectura tiene éxito.
+PgmStatus readPGMFile(const std::string& filename, PixelBuffer& image,
+                      size_t* bytesRead = nullptr);
+
+// Deja en out el archivo PGM completo del corte 0 de image, listo para
+// escribirse (por ejemplo desde otro hilo, ver escritura_diferida.h).
+void formatPGM(const PixelBuffer& image, PgmFormat format, const std::string& comment,
+               std::vector<char>& out);
+
+// Escribe el corte 0 de image. comment (si no está vacío) va como línea '#'.
+// Las filas se formatean en un buffer y se escriben en bloques de 1 MB.
+PgmStatus writePGMFile(const std::string& filename, const PixelBuffer& image,
+                       PgmFormat format, const std::string& comment = "");
+
+#endif
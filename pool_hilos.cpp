@@ -0,0 +1,148 @@
+#include "pool_hilos.h"
+
+#include <algorithm>
+#include "perfil.h"
+
+namespace {
+thread_local bool insidePool = false;   // true mientras el hilo ejecuta una tarea del pool
+}
+
+ThreadPool::ThreadPool(unsigned threads)
+  : stopping_(false), generation_(0), busy_(0), task_(nullptr), profile_(nullptr) {
+    startWorkers(threads);
+}
+
+ThreadPool::~ThreadPool() {
+    stopWorkers();
+}
+
+void ThreadPool::startWorkers(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+
+    stopping_ = false;
+    queues_.clear();
+    for (unsigned t = 0; t < threads; ++t) queues_.emplace_back(new WorkQueue);
+    for (unsigned t = 1; t < threads; ++t)        // El hilo que llama es el trabajador 0
+        workers_.emplace_back(&ThreadPool::workerLoop, this, t, generation_);
+}
+
+void ThreadPool::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) worker.join();
+    workers_.clear();
+}
+
+void ThreadPool::resize(unsigned threads) {
+    std::lock_guard<std::mutex> submit(submit_);   // Espera a que termine el trabajo en curso
+    stopWorkers();
+    startWorkers(threads);
+}
+
+size_t ThreadPool::grainFor(size_t count) const {
+    size_t pieces = static_cast<size_t>(size()) * 4;
+    return std::max<size_t>(1, (count + pieces - 1) / pieces);
+}
+
+bool ThreadPool::popChunk(unsigned id, std::pair<size_t, size_t>& chunk) {
+    // Primero la cola propia, por delante
+    {
+        WorkQueue& own = *queues_[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.front();
+            own.chunks.pop_front();
+            return true;
+        }
+    }
+    // Luego robar del final de las demás
+    const size_t n = queues_.size();
+    for (size_t step = 1; step < n; ++step) {
+        WorkQueue& victim = *queues_[(id + step) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.back();
+            victim.chunks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runChunks(unsigned id) {
+    std::pair<size_t, size_t> chunk;
+    while (popChunk(id, chunk)) (*task_)(chunk.first, chunk.second);
+}
+
+void ThreadPool::workerLoop(unsigned id, unsigned long seen) {
+    insidePool = true;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+        if (stopping_) return;
+        seen = generation_;
+        ProfileCounters* profile = profile_;
+
+        lock.unlock();
+        {
+            ProfileScope scope(profile);
+            runChunks(id);
+        }
+        lock.lock();
+
+        if (--busy_ == 0) done_.notify_all();
+    }
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain, const RangeTask& task) {
+    if (end <= begin) return;
+    if (grain == 0) grain = 1;
+
+    // Sin hilos extra, con un solo bloque o desde dentro de otra tarea: en serie
+    if (workers_.empty() || insidePool || end - begin <= grain) {
+        task(begin, end);
+        return;
+    }
+
+    // Si otro hilo externo está usando el pool, este trabajo se hace en serie
+    std::unique_lock<std::mutex> submit(submit_, std::try_to_lock);
+    if (!submit.owns_lock()) {
+        task(begin, end);
+        return;
+    }
+
+    // Repartir bloques contiguos entre las colas, en partes casi iguales
+    const size_t chunks = (end - begin + grain - 1) / grain;
+    const size_t n = queues_.size();
+    size_t chunk = 0;
+    for (size_t q = 0; q < n; ++q) {
+        size_t last = chunks * (q + 1) / n;
+        std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+        for (; chunk < last; ++chunk) {
+            size_t b = begin + chunk * grain;
+            queues_[q]->chunks.push_back(std::make_pair(b, std::min(b + grain, end)));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        profile_ = sessionProfile();
+        busy_ = static_cast<unsigned>(workers_.size());
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    insidePool = true;
+    runChunks(0);
+    insidePool = false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return busy_ == 0; });
+    task_ = nullptr;
+    profile_ = nullptr;
+}
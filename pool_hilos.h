@@ -0,0 +1,73 @@
+#ifndef POOL_HILOS_H
+#define POOL_HILOS_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct ProfileCounters;
+
+// ————————————
+// Pool persistente de hilos de trabajo con robo de tareas.
+//
+// Los hilos se crean una sola vez y esperan trabajo. parallelFor parte un
+// rango de índices en bloques de tamaño grain y reparte bloques contiguos
+// en una cola por hilo; cada hilo consume su cola por delante y, cuando se
+// queda sin trabajo, roba bloques del final de las colas ajenas. Así los
+// bloques de costo desigual quedan balanceados. El hilo que llama también
+// trabaja y la llamada vuelve cuando se procesó todo el rango.
+//
+// Una llamada hecha desde dentro de una tarea del pool, o mientras otro
+// hilo externo lo está usando, se ejecuta en serie en el hilo que llama.
+// Lo que miden los hilos del pool se suma a la sesión de quien publicó el
+// trabajo (ver perfil.h).
+//————————————
+class ThreadPool {
+public:
+    typedef std::function<void(size_t, size_t)> RangeTask;  // Procesa [begin, end)
+
+    explicit ThreadPool(unsigned threads = 0);  // 0 = núcleos disponibles
+    ~ThreadPool();
+
+    unsigned size() const { return static_cast<unsigned>(workers_.size()) + 1; }
+    void resize(unsigned threads);              // 0 = núcleos disponibles
+
+    void parallelFor(size_t begin, size_t end, size_t grain, const RangeTask& task);
+
+    // Tamaño de bloque que deja unos cuantos bloques por hilo para balancear.
+    size_t grainFor(size_t count) const;
+
+private:
+    ThreadPool(const ThreadPool&);              // No copiable
+    ThreadPool& operator=(const ThreadPool&);
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::pair<size_t, size_t> > chunks;
+    };
+
+    void startWorkers(unsigned threads);
+    void stopWorkers();
+    void workerLoop(unsigned id, unsigned long seen);  // seen: último trabajo ya visto
+    void runChunks(unsigned id);
+    bool popChunk(unsigned id, std::pair<size_t, size_t>& chunk);
+
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<WorkQueue> > queues_;  // Una por hilo; la 0 es del que llama
+    std::mutex submit_;             // Un solo trabajo publicado a la vez
+    std::mutex mutex_;
+    std::condition_variable wake_, done_;
+    bool stopping_;
+    unsigned long generation_;      // Cambia con cada trabajo publicado
+    unsigned busy_;                 // Hilos del pool aún dentro del trabajo actual
+    const RangeTask* task_;         // Trabajo actual
+    ProfileCounters* profile_;      // Sesión de quien lo publicó
+};
+
+#endif
@@ -0,0 +1,681 @@
+#include "proyeccion.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// ————————————
+// Operaciones de acumulación. fold combina una fila completa en un vector
+// de acumuladores; reduce resume una fila en un solo acumulador; finish
+// convierte el acumulador en el valor de salida (count = largo del rayo).
+//————————————
+template <typename T> struct SumType;
+template <> struct SumType<uint8_t>  { typedef uint32_t type; };
+template <> struct SumType<uint16_t> { typedef uint64_t type; };
+
+template <typename T>
+struct MaxOp {
+    typedef T Acc;
+    static Acc identity() { return 0; }
+    static void fold(Acc* __restrict acc, const T* __restrict row, int n) {
+        for (int j = 0; j < n; ++j) acc[j] = row[j] > acc[j] ? row[j] : acc[j];
+    }
+    static Acc reduce(const T* __restrict row, int n) {
+        Acc a = identity();
+        for (int j = 0; j < n; ++j) a = row[j] > a ? row[j] : a;
+        return a;
+    }
+    static T finish(Acc a, int) { return a; }
+};
+
+template <typename T>
+struct MinOp {
+    typedef T Acc;
+    static Acc identity() { return std::numeric_limits<T>::max(); }
+    static void fold(Acc* __restrict acc, const T* __restrict row, int n) {
+        for (int j = 0; j < n; ++j) acc[j] = row[j] < acc[j] ? row[j] : acc[j];
+    }
+    static Acc reduce(const T* __restrict row, int n) {
+        Acc a = identity();
+        for (int j = 0; j < n; ++j) a = row[j] < a ? row[j] : a;
+        return a;
+    }
+    static T finish(Acc a, int) { return a; }
+};
+
+template <typename T>
+struct MeanOp {
+    typedef typename SumType<T>::type Acc;
+    static Acc identity() { return 0; }
+    static void fold(Acc* __restrict acc, const T* __restrict row, int n) {
+        for (int j = 0; j < n; ++j) acc[j] += row[j];
+    }
+    static Acc reduce(const T* __restrict row, int n) {
+        Acc a = 0;
+        for (int j = 0; j < n; ++j) a += row[j];
+        return a;
+    }
+    static T finish(Acc a, int count) { return static_cast<T>(a / count); }  // División entera
+};
+
+// ————————————
+// Núcleos por dirección. Cada uno procesa un rango de filas (z, x) o de
+// cortes (y) de la salida.
+//————————————
+
+// z: salida[i][j] = op sobre k de vol[k][i][j]. Por cada fila i se recorren
+// las filas (k, i) de todos los cortes y se acumulan completas.
+template <typename T, typename Op>
+void foldZ(const PixelBuffer& vol, PixelBuffer& out, int rowBegin, int rowEnd) {
+    const int width = vol.width(), depth = vol.depth();
+    std::vector<typename Op::Acc> acc(width);
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        std::fill(acc.begin(), acc.end(), Op::identity());
+        for (int k = 0; k < depth; ++k) Op::fold(acc.data(), vol.row<T>(k, i), width);
+        T* dst = out.row<T>(0, i);
+        for (int j = 0; j < width; ++j) dst[j] = Op::finish(acc[j], depth);
+    }
+}
+
+// y: salida[k][j] = op sobre i de vol[k][i][j]. Cada corte se recorre linealmente.
+template <typename T, typename Op>
+void foldY(const PixelBuffer& vol, PixelBuffer& out, int sliceBegin, int sliceEnd) {
+    const int width = vol.width(), height = vol.height();
+    std::vector<typename Op::Acc> acc(width);
+    for (int k = sliceBegin; k < sliceEnd; ++k) {
+        std::fill(acc.begin(), acc.end(), Op::identity());
+        for (int i = 0; i < height; ++i) Op::fold(acc.data(), vol.row<T>(k, i), width);
+        T* dst = out.row<T>(0, k);
+        for (int j = 0; j < width; ++j) dst[j] = Op::finish(acc[j], height);
+    }
+}
+
+// x: salida[i][k] = op sobre j de vol[k][i][j]. Cada fila se reduce entera.
+template <typename T, typename Op>
+void foldX(const PixelBuffer& vol, PixelBuffer& out, int rowBegin, int rowEnd) {
+    const int width = vol.width(), depth = vol.depth();
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        T* dst = out.row<T>(0, i);
+        for (int k = 0; k < depth; ++k) dst[k] = Op::finish(Op::reduce(vol.row<T>(k, i), width), width);
+    }
+}
+
+// ————————————
+// Mediana. Con pocos niveles de gris (M + 1 <= kMaxHistogramBins) se usa
+// un histograma por rayo: cada valor se cuenta una vez y la mediana sale de
+// recorrer los conteos acumulados, en tiempo lineal. En z e y se mantienen
+// los histogramas de toda una fila de salida y se actualizan a medida que
+// pasan las filas de los cortes. Con más niveles se ordena cada rayo.
+// En ambos casos, con cantidad par se promedian los dos valores centrales
+// (división entera), igual que antes.
+//————————————
+const int kMaxHistogramBins = 1024;
+
+// Mediana de n valores contados en hist (bins entradas).
+template <typename C>
+unsigned histogramMedian(const C* hist, int bins, int n) {
+    const unsigned lo = (n - 1) / 2, hi = n / 2;   // Rangos (desde 0) de los centrales
+    unsigned seen = 0, low = 0;
+    int v = 0;
+    for (; v < bins; ++v) {
+        seen += hist[v];
+        if (seen > lo) { low = v; break; }
+    }
+    if (seen > hi) return low;                      // Ambos centrales son el mismo valor
+    for (++v; v < bins; ++v) {
+        if (hist[v]) return (low + v) / 2;
+    }
+    return low;
+}
+
+// z: una fila de histogramas (uno por columna) por cada fila i de salida.
+template <typename T, typename C>
+void histMedianZ(const PixelBuffer& vol, PixelBuffer& out, int rowBegin, int rowEnd) {
+    const int width = vol.width(), depth = vol.depth(), bins = vol.maxValue() + 1;
+    std::vector<C> hist(static_cast<size_t>(width) * bins, 0);
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        for (int k = 0; k < depth; ++k) {
+            const T* row = vol.row<T>(k, i);
+            C* h = hist.data();
+            for (int j = 0; j < width; ++j, h += bins) ++h[row[j]];
+        }
+        T* dst = out.row<T>(0, i);
+        for (int j = 0; j < width; ++j)
+            dst[j] = static_cast<T>(histogramMedian(hist.data() + static_cast<size_t>(j) * bins, bins, depth));
+        // Volver a cero solo las entradas tocadas
+        for (int k = 0; k < depth; ++k) {
+            const T* row = vol.row<T>(k, i);
+            C* h = hist.data();
+            for (int j = 0; j < width; ++j, h += bins) h[row[j]] = 0;
+        }
+    }
+}
+
+// y: una fila de histogramas por corte, alimentada fila a fila.
+template <typename T, typename C>
+void histMedianY(const PixelBuffer& vol, PixelBuffer& out, int sliceBegin, int sliceEnd) {
+    const int width = vol.width(), height = vol.height(), bins = vol.maxValue() + 1;
+    std::vector<C> hist(static_cast<size_t>(width) * bins, 0);
+    for (int k = sliceBegin; k < sliceEnd; ++k) {
+        for (int i = 0; i < height; ++i) {
+            const T* row = vol.row<T>(k, i);
+            C* h = hist.data();
+            for (int j = 0; j < width; ++j, h += bins) ++h[row[j]];
+        }
+        T* dst = out.row<T>(0, k);
+        for (int j = 0; j < width; ++j)
+            dst[j] = static_cast<T>(histogramMedian(hist.data() + static_cast<size_t>(j) * bins, bins, height));
+        for (int i = 0; i < height; ++i) {
+            const T* row = vol.row<T>(k, i);
+            C* h = hist.data();
+            for (int j = 0; j < width; ++j, h += bins) h[row[j]] = 0;
+        }
+    }
+}
+
+// x: un solo histograma por rayo (la fila completa).
+template <typename T, typename C>
+void histMedianX(const PixelBuffer& vol, PixelBuffer& out, int rowBegin, int rowEnd) {
+    const int width = vol.width(), depth = vol.depth(), bins = vol.maxValue() + 1;
+    std::vector<C> hist(bins, 0);
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        T* dst = out.row<T>(0, i);
+        for (int k = 0; k < depth; ++k) {
+            const T* row = vol.row<T>(k, i);
+            for (int j = 0; j < width; ++j) ++hist[row[j]];
+            dst[k] = static_cast<T>(histogramMedian(hist.data(), bins, width));
+            for (int j = 0; j < width; ++j) hist[row[j]] = 0;
+        }
+    }
+}
+
+// Mediana de un rayo ya copiado en values, ordenándolo (datos profundos).
+template <typename T>
+T rayMedian(T* values, int n) {
+    std::sort(values, values + n);
+    if (n % 2 == 1) return values[n / 2];
+    return static_cast<T>((static_cast<unsigned>(values[n / 2 - 1]) + values[n / 2]) / 2);
+}
+
+template <typename T>
+void sortMedianZ(const PixelBuffer& vol, PixelBuffer& out, int rowBegin, int rowEnd) {
+    const int width = vol.width(), depth = vol.depth();
+    std::vector<T> rows(static_cast<size_t>(depth) * width), ray(depth);
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        // Copiar las filas (k, i) contiguas para que cada rayo quede en caché
+        for (int k = 0; k < depth; ++k)
+            std::copy(vol.row<T>(k, i), vol.row<T>(k, i) + width, rows.begin() + static_cast<size_t>(k) * width);
+        T* dst = out.row<T>(0, i);
+        for (int j = 0; j < width; ++j) {
+            for (int k = 0; k < depth; ++k) ray[k] = rows[static_cast<size_t>(k) * width + j];
+            dst[j] = rayMedian(ray.data(), depth);
+        }
+    }
+}
+
+template <typename T>
+void sortMedianY(const PixelBuffer& vol, PixelBuffer& out, int sliceBegin, int sliceEnd) {
+    const int width = vol.width(), height = vol.height();
+    std::vector<T> ray(height);
+    for (int k = sliceBegin; k < sliceEnd; ++k) {
+        T* dst = out.row<T>(0, k);
+        for (int j = 0; j < width; ++j) {
+            for (int i = 0; i < height; ++i) ray[i] = vol.row<T>(k, i)[j];
+            dst[j] = rayMedian(ray.data(), height);
+        }
+    }
+}
+
+template <typename T>
+void sortMedianX(const PixelBuffer& vol, PixelBuffer& out, int rowBegin, int rowEnd) {
+    const int width = vol.width(), depth = vol.depth();
+    std::vector<T> ray(width);
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        T* dst = out.row<T>(0, i);
+        for (int k = 0; k < depth; ++k) {
+            std::copy(vol.row<T>(k, i), vol.row<T>(k, i) + width, ray.begin());
+            dst[k] = rayMedian(ray.data(), width);
+        }
+    }
+}
+
+// Cantidad de unidades de trabajo (filas o cortes de salida) de cada dirección.
+int tileCount(const PixelBuffer& vol, ProjectionAxis axis) {
+    return axis == ProjectionAxis::Y ? vol.depth() : vol.height();
+}
+
+// Reparte las filas (z, x) o cortes (y) de salida entre los hilos del pool.
+// Cada píxel de salida depende solo de su rayo, así que el resultado es
+// idéntico con cualquier cantidad de hilos.
+template <typename T, typename Op>
+void runFold(const PixelBuffer& vol, ProjectionAxis axis, PixelBuffer& out, ThreadPool& pool) {
+    const int tiles = tileCount(vol, axis);
+    pool.parallelFor(0, tiles, pool.grainFor(tiles), [&](size_t b, size_t e) {
+        switch (axis) {
+        case ProjectionAxis::Z: foldZ<T, Op>(vol, out, static_cast<int>(b), static_cast<int>(e)); break;
+        case ProjectionAxis::Y: foldY<T, Op>(vol, out, static_cast<int>(b), static_cast<int>(e)); break;
+        case ProjectionAxis::X: foldX<T, Op>(vol, out, static_cast<int>(b), static_cast<int>(e)); break;
+        }
+    });
+}
+
+template <typename T, typename C>
+void runHistogramMedian(const PixelBuffer& vol, ProjectionAxis axis, PixelBuffer& out, ThreadPool& pool) {
+    const int tiles = tileCount(vol, axis);
+    pool.parallelFor(0, tiles, pool.grainFor(tiles), [&](size_t b, size_t e) {
+        switch (axis) {
+        case ProjectionAxis::Z: histMedianZ<T, C>(vol, out, static_cast<int>(b), static_cast<int>(e)); break;
+        case ProjectionAxis::Y: histMedianY<T, C>(vol, out, static_cast<int>(b), static_cast<int>(e)); break;
+        case ProjectionAxis::X: histMedianX<T, C>(vol, out, static_cast<int>(b), static_cast<int>(e)); break;
+        }
+    });
+}
+
+template <typename T>
+void runMedian(const PixelBuffer& vol, ProjectionAxis axis, PixelBuffer& out, ThreadPool& pool) {
+    if (vol.maxValue() + 1 <= kMaxHistogramBins) {
+        // Contadores de 16 bits mientras el rayo más largo quepa en ellos
+        int rayLength = axis == ProjectionAxis::Z ? vol.depth()
+                      : axis == ProjectionAxis::Y ? vol.height() : vol.width();
+        if (rayLength <= 0xffff) runHistogramMedian<T, uint16_t>(vol, axis, out, pool);
+        else runHistogramMedian<T, uint32_t>(vol, axis, out, pool);
+        return;
+    }
+    const int tiles = tileCount(vol, axis);
+    pool.parallelFor(0, tiles, pool.grainFor(tiles), [&](size_t b, size_t e) {
+        switch (axis) {
+        case ProjectionAxis::Z: sortMedianZ<T>(vol, out, static_cast<int>(b), static_cast<int>(e)); break;
+        case ProjectionAxis::Y: sortMedianY<T>(vol, out, static_cast<int>(b), static_cast<int>(e)); break;
+        case ProjectionAxis::X: sortMedianX<T>(vol, out, static_cast<int>(b), static_cast<int>(e)); break;
+        }
+    });
+}
+
+template <typename T>
+void runProjection(const PixelBuffer& vol, ProjectionAxis axis,
+                   ProjectionCriterion criterion, PixelBuffer& out, ThreadPool& pool) {
+    switch (criterion) {
+    case ProjectionCriterion::Max:    runFold<T, MaxOp<T> >(vol, axis, out, pool); break;
+    case ProjectionCriterion::Min:    runFold<T, MinOp<T> >(vol, axis, out, pool); break;
+    case ProjectionCriterion::Mean:   runFold<T, MeanOp<T> >(vol, axis, out, pool); break;
+    case ProjectionCriterion::Median: runMedian<T>(vol, axis, out, pool); break;
+    }
+}
+
+// ————————————
+// Proyección combinada: varios criterios en un solo recorrido. Cada fila
+// del volumen se lee de memoria una vez y, mientras sigue en caché,
+// alimenta los acumuladores de todos los criterios pedidos. Los
+// acumuladores y la mediana son los mismos que en los núcleos de un solo
+// criterio, así que cada salida es idéntica a la de projectVolume.
+//————————————
+const int kCriterionCount = 4;
+
+struct FusedTargets {
+    PixelBuffer* out[kCriterionCount];      // Indexado por criterio; nullptr = no pedido
+    bool histogramMedian;                   // Mediana por histograma u ordenando el rayo
+};
+
+template <typename T>
+T* targetRow(const FusedTargets& targets, ProjectionCriterion c, int row) {
+    PixelBuffer* out = targets.out[static_cast<int>(c)];
+    return out ? out->row<T>(0, row) : nullptr;
+}
+
+// Rayos de una fila de salida en z (una fila por corte) o en y (una fila
+// por fila del corte): begin, length llamadas a add y end.
+template <typename T, typename C>
+class FusedRays {
+public:
+    FusedRays(const FusedTargets& targets, int width, int bins, int length)
+      : targets_(targets), width_(width), bins_(bins), length_(length), rows_(length) {
+        if (targets.out[static_cast<int>(ProjectionCriterion::Max)]) max_.resize(width);
+        if (targets.out[static_cast<int>(ProjectionCriterion::Min)]) min_.resize(width);
+        if (targets.out[static_cast<int>(ProjectionCriterion::Mean)]) sum_.resize(width);
+        if (targets.out[static_cast<int>(ProjectionCriterion::Median)]) {
+            if (targets.histogramMedian) hist_.assign(static_cast<size_t>(width) * bins, 0);
+            else rays_.resize(static_cast<size_t>(length) * width);
+        }
+    }
+
+    void begin() {
+        std::fill(max_.begin(), max_.end(), MaxOp<T>::identity());
+        std::fill(min_.begin(), min_.end(), MinOp<T>::identity());
+        std::fill(sum_.begin(), sum_.end(), MeanOp<T>::identity());
+    }
+
+    void add(const T* row, int index) {
+        rows_[index] = row;
+        if (!max_.empty()) MaxOp<T>::fold(max_.data(), row, width_);
+        if (!min_.empty()) MinOp<T>::fold(min_.data(), row, width_);
+        if (!sum_.empty()) MeanOp<T>::fold(sum_.data(), row, width_);
+        if (!hist_.empty()) {
+            C* h = hist_.data();
+            for (int j = 0; j < width_; ++j, h += bins_) ++h[row[j]];
+        } else if (!rays_.empty()) {
+            std::copy(row, row + width_, rays_.begin() + static_cast<size_t>(index) * width_);
+        }
+    }
+
+    void end(int outRow) {
+        if (T* dst = targetRow<T>(targets_, ProjectionCriterion::Max, outRow))
+            for (int j = 0; j < width_; ++j) dst[j] = MaxOp<T>::finish(max_[j], length_);
+        if (T* dst = targetRow<T>(targets_, ProjectionCriterion::Min, outRow))
+            for (int j = 0; j < width_; ++j) dst[j] = MinOp<T>::finish(min_[j], length_);
+        if (T* dst = targetRow<T>(targets_, ProjectionCriterion::Mean, outRow))
+            for (int j = 0; j < width_; ++j) dst[j] = MeanOp<T>::finish(sum_[j], length_);
+        T* dst = targetRow<T>(targets_, ProjectionCriterion::Median, outRow);
+        if (dst && !hist_.empty()) {
+            for (int j = 0; j < width_; ++j)
+                dst[j] = static_cast<T>(histogramMedian(hist_.data() + static_cast<size_t>(j) * bins_, bins_, length_));
+            // Volver a cero solo las entradas tocadas (las filas siguen en caché)
+            for (int r = 0; r < length_; ++r) {
+                C* h = hist_.data();
+                for (int j = 0; j < width_; ++j, h += bins_) h[rows_[r][j]] = 0;
+            }
+        } else if (dst) {
+            std::vector<T> ray(length_);
+            for (int j = 0; j < width_; ++j) {
+                for (int r = 0; r < length_; ++r) ray[r] = rays_[static_cast<size_t>(r) * width_ + j];
+                dst[j] = rayMedian(ray.data(), length_);
+            }
+        }
+    }
+
+private:
+    const FusedTargets& targets_;
+    const int width_, bins_, length_;
+    std::vector<const T*> rows_;
+    std::vector<T> max_, min_;
+    std::vector<typename SumType<T>::type> sum_;
+    std::vector<C> hist_;
+    std::vector<T> rays_;
+};
+
+template <typename T, typename C>
+void fusedZ(const PixelBuffer& vol, const FusedTargets& targets, int rowBegin, int rowEnd) {
+    FusedRays<T, C> rays(targets, vol.width(), vol.maxValue() + 1, vol.depth());
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        rays.begin();
+        for (int k = 0; k < vol.depth(); ++k) rays.add(vol.row<T>(k, i), k);
+        rays.end(i);
+    }
+}
+
+template <typename T, typename C>
+void fusedY(const PixelBuffer& vol, const FusedTargets& targets, int sliceBegin, int sliceEnd) {
+    FusedRays<T, C> rays(targets, vol.width(), vol.maxValue() + 1, vol.height());
+    for (int k = sliceBegin; k < sliceEnd; ++k) {
+        rays.begin();
+        for (int i = 0; i < vol.height(); ++i) rays.add(vol.row<T>(k, i), i);
+        rays.end(k);
+    }
+}
+
+// x: cada fila del volumen es un rayo entero y da un píxel de cada salida.
+template <typename T, typename C>
+void fusedX(const PixelBuffer& vol, const FusedTargets& targets, int rowBegin, int rowEnd) {
+    const int width = vol.width(), depth = vol.depth(), bins = vol.maxValue() + 1;
+    const bool median = targets.out[static_cast<int>(ProjectionCriterion::Median)] != nullptr;
+    std::vector<C> hist(median && targets.histogramMedian ? bins : 0, 0);
+    std::vector<T> ray(median && !targets.histogramMedian ? width : 0);
+    for (int i = rowBegin; i < rowEnd; ++i) {
+        T* maxRow = targetRow<T>(targets, ProjectionCriterion::Max, i);
+        T* minRow = targetRow<T>(targets, ProjectionCriterion::Min, i);
+        T* meanRow = targetRow<T>(targets, ProjectionCriterion::Mean, i);
+        T* medianRow = targetRow<T>(targets, ProjectionCriterion::Median, i);
+        for (int k = 0; k < depth; ++k) {
+            const T* row = vol.row<T>(k, i);
+            if (maxRow) maxRow[k] = MaxOp<T>::finish(MaxOp<T>::reduce(row, width), width);
+            if (minRow) minRow[k] = MinOp<T>::finish(MinOp<T>::reduce(row, width), width);
+            if (meanRow) meanRow[k] = MeanOp<T>::finish(MeanOp<T>::reduce(row, width), width);
+            if (!hist.empty()) {
+                for (int j = 0; j < width; ++j) ++hist[row[j]];
+                medianRow[k] = static_cast<T>(histogramMedian(hist.data(), bins, width));
+                for (int j = 0; j < width; ++j) hist[row[j]] = 0;
+            } else if (medianRow) {
+                std::copy(row, row + width, ray.begin());
+                medianRow[k] = rayMedian(ray.data(), width);
+            }
+        }
+    }
+}
+
+template <typename T, typename C>
+void runFused(const PixelBuffer& vol, ProjectionAxis axis, const FusedTargets& targets, ThreadPool& pool) {
+    const int tiles = tileCount(vol, axis);
+    pool.parallelFor(0, tiles, pool.grainFor(tiles), [&](size_t b, size_t e) {
+        switch (axis) {
+        case ProjectionAxis::Z: fusedZ<T, C>(vol, targets, static_cast<int>(b), static_cast<int>(e)); break;
+        case ProjectionAxis::Y: fusedY<T, C>(vol, targets, static_cast<int>(b), static_cast<int>(e)); break;
+        case ProjectionAxis::X: fusedX<T, C>(vol, targets, static_cast<int>(b), static_cast<int>(e)); break;
+        }
+    });
+}
+
+}  // namespace
+
+// ————————————
+// Proyección z por flujo de cortes
+//————————————
+struct StreamingZProjection::State {
+    virtual ~State() {}
+    virtual int passes() const { return 1; }
+    virtual void add(const PixelBuffer& slice, ThreadPool& pool) = 0;
+    virtual void endPass() {}
+    virtual void finish(PixelBuffer& result, ThreadPool& pool) = 0;
+};
+
+namespace {
+
+// Máximo, mínimo y promedio: un acumulador por píxel, una sola pasada.
+template <typename T, typename Op>
+class FoldStream : public StreamingZProjection::State {
+public:
+    FoldStream(int width, int height, int maxValue, int depth)
+      : width_(width), height_(height), maxValue_(maxValue), depth_(depth),
+        acc_(static_cast<size_t>(width) * height, Op::identity()) {}
+
+    void add(const PixelBuffer& slice, ThreadPool& pool) {
+        pool.parallelFor(0, height_, pool.grainFor(height_), [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i)
+                Op::fold(&acc_[i * width_], slice.row<T>(0, static_cast<int>(i)), width_);
+        });
+    }
+
+    void finish(PixelBuffer& result, ThreadPool& pool) {
+        result.allocate(width_, height_, 1, maxValue_);
+        pool.parallelFor(0, height_, pool.grainFor(height_), [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i) {
+                T* dst = result.row<T>(0, static_cast<int>(i));
+                for (int j = 0; j < width_; ++j) dst[j] = Op::finish(acc_[i * width_ + j], depth_);
+            }
+        });
+    }
+
+private:
+    const int width_, height_, maxValue_, depth_;
+    std::vector<typename Op::Acc> acc_;
+};
+
+// Mediana por selección de dígitos de 4 bits, del más alto al más bajo.
+template <typename T>
+class MedianStream : public StreamingZProjection::State {
+public:
+    MedianStream(int width, int height, int maxValue, int depth)
+      : width_(width), height_(height), maxValue_(maxValue), depth_(depth), digits_(1), pass_(0),
+        counts_(static_cast<size_t>(width) * height * kDigitValues, 0),
+        prefix_(static_cast<size_t>(width) * height, 0),
+        rank_(static_cast<size_t>(width) * height, static_cast<uint8_t>((depth - 1) / 2)) {
+        while (maxValue >> (4 * digits_)) ++digits_;
+    }
+
+    // Una pasada por dígito y, con cantidad par, otra para el segundo central
+    int passes() const { return digits_ + (depth_ % 2 == 0 ? 1 : 0); }
+
+    void add(const PixelBuffer& slice, ThreadPool& pool) {
+        const bool selecting = pass_ < digits_;
+        const int shift = selecting ? 4 * (digits_ - 1 - pass_) : 0;
+        pool.parallelFor(0, height_, pool.grainFor(height_), [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i) {
+                const T* row = slice.row<T>(0, static_cast<int>(i));
+                const size_t p0 = i * width_;
+                for (int j = 0; j < width_; ++j) {
+                    const unsigned v = row[j], prefix = prefix_[p0 + j];
+                    if (selecting) {
+                        // Solo cuentan los valores con los dígitos altos ya fijados
+                        if ((v >> shift >> 4) == (prefix >> shift >> 4))
+                            ++counts_[(p0 + j) * kDigitValues + ((v >> shift) & 0xf)];
+                    } else if (v <= prefix) {
+                        ++counts_[(p0 + j) * kDigitValues];        // Cuántos valores <= primer central
+                    } else if (v < next_[p0 + j]) {
+                        next_[p0 + j] = static_cast<T>(v);         // Menor valor por encima
+                    }
+                }
+            }
+        });
+    }
+
+    void endPass() {
+        if (pass_ < digits_) {
+            const int shift = 4 * (digits_ - 1 - pass_);
+            const size_t pixels = prefix_.size();
+            for (size_t p = 0; p < pixels; ++p) {
+                uint8_t* count = &counts_[p * kDigitValues];
+                unsigned below = 0, d = 0;
+                while (d + 1 < kDigitValues && below + count[d] <= rank_[p]) below += count[d++];
+                rank_[p] = static_cast<uint8_t>(rank_[p] - below);
+                prefix_[p] = static_cast<T>(prefix_[p] | d << shift);
+                std::fill(count, count + kDigitValues, 0);
+            }
+            if (pass_ == digits_ - 1 && depth_ % 2 == 0)
+                next_.assign(pixels, std::numeric_limits<T>::max());
+        }
+        ++pass_;
+    }
+
+    void finish(PixelBuffer& result, ThreadPool& pool) {
+        result.allocate(width_, height_, 1, maxValue_);
+        const unsigned hi = depth_ / 2;
+        pool.parallelFor(0, height_, pool.grainFor(height_), [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i) {
+                T* dst = result.row<T>(0, static_cast<int>(i));
+                for (int j = 0; j < width_; ++j) {
+                    const size_t p = i * width_ + j;
+                    const unsigned low = prefix_[p];
+                    if (depth_ % 2 == 1) {
+                        dst[j] = static_cast<T>(low);
+                    } else {
+                        const unsigned high = counts_[p * kDigitValues] > hi ? low : next_[p];
+                        dst[j] = static_cast<T>((low + high) / 2);
+                    }
+                }
+            }
+        });
+    }
+
+private:
+    static const unsigned kDigitValues = 16;
+
+    const int width_, height_, maxValue_, depth_;
+    int digits_, pass_;
+    std::vector<uint8_t> counts_;     // 16 contadores por píxel
+    std::vector<T> prefix_;           // Dígitos ya fijados del primer valor central
+    std::vector<uint8_t> rank_;       // Posición buscada dentro de los que coinciden
+    std::vector<T> next_;             // Solo en la pasada extra
+};
+
+template <typename T>
+StreamingZProjection::State* makeStream(int width, int height, int maxValue, int depth,
+                                        ProjectionCriterion criterion) {
+    switch (criterion) {
+    case ProjectionCriterion::Max:    return new FoldStream<T, MaxOp<T> >(width, height, maxValue, depth);
+    case ProjectionCriterion::Min:    return new FoldStream<T, MinOp<T> >(width, height, maxValue, depth);
+    case ProjectionCriterion::Mean:   return new FoldStream<T, MeanOp<T> >(width, height, maxValue, depth);
+    case ProjectionCriterion::Median: return new MedianStream<T>(width, height, maxValue, depth);
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+bool parseProjectionAxis(const std::string& name, ProjectionAxis& axis) {
+    if (name == "x") axis = ProjectionAxis::X;
+    else if (name == "y") axis = ProjectionAxis::Y;
+    else if (name == "z") axis = ProjectionAxis::Z;
+    else return false;
+    return true;
+}
+
+bool parseProjectionCriterion(const std::string& name, ProjectionCriterion& criterion) {
+    if (name == "max") criterion = ProjectionCriterion::Max;
+    else if (name == "min") criterion = ProjectionCriterion::Min;
+    else if (name == "prom") criterion = ProjectionCriterion::Mean;
+    else if (name == "med") criterion = ProjectionCriterion::Median;
+    else return false;
+    return true;
+}
+
+void projectVolume(const PixelBuffer& volume, ProjectionAxis axis,
+                   ProjectionCriterion criterion, PixelBuffer& result, ThreadPool& pool) {
+    const int width = volume.width(), height = volume.height(), depth = volume.depth();
+    switch (axis) {
+    case ProjectionAxis::Z: result.allocate(width, height, 1, volume.maxValue()); break;
+    case ProjectionAxis::Y: result.allocate(width, depth, 1, volume.maxValue()); break;
+    case ProjectionAxis::X: result.allocate(depth, height, 1, volume.maxValue()); break;
+    }
+
+    if (volume.wide()) runProjection<uint16_t>(volume, axis, criterion, result, pool);
+    else runProjection<uint8_t>(volume, axis, criterion, result, pool);
+}
+
+void projectVolumeFused(const PixelBuffer& volume, ProjectionAxis axis,
+                        const std::vector<ProjectionCriterion>& criteria,
+                        std::vector<PixelBuffer>& results, ThreadPool& pool) {
+    FusedTargets targets = { { nullptr, nullptr, nullptr, nullptr }, volume.maxValue() + 1 <= kMaxHistogramBins };
+    results.assign(criteria.size(), PixelBuffer());
+    for (size_t c = 0; c < criteria.size(); ++c) {
+        PixelBuffer*& out = targets.out[static_cast<int>(criteria[c])];
+        if (out) continue;                          // Criterio repetido: se copia al final
+        out = &results[c];
+        switch (axis) {
+        case ProjectionAxis::Z: out->allocate(volume.width(), volume.height(), 1, volume.maxValue()); break;
+        case ProjectionAxis::Y: out->allocate(volume.width(), volume.depth(), 1, volume.maxValue()); break;
+        case ProjectionAxis::X: out->allocate(volume.depth(), volume.height(), 1, volume.maxValue()); break;
+        }
+    }
+
+    // Contadores de 16 bits mientras el rayo más largo quepa en ellos, como en runMedian
+    const int rayLength = axis == ProjectionAxis::Z ? volume.depth()
+                        : axis == ProjectionAxis::Y ? volume.height() : volume.width();
+    if (volume.wide()) {
+        if (rayLength <= 0xffff) runFused<uint16_t, uint16_t>(volume, axis, targets, pool);
+        else runFused<uint16_t, uint32_t>(volume, axis, targets, pool);
+    } else {
+        if (rayLength <= 0xffff) runFused<uint8_t, uint16_t>(volume, axis, targets, pool);
+        else runFused<uint8_t, uint32_t>(volume, axis, targets, pool);
+    }
+
+    for (size_t c = 0; c < criteria.size(); ++c) {
+        const PixelBuffer* out = targets.out[static_cast<int>(criteria[c])];
+        if (out != &results[c]) results[c] = *out;
+    }
+}
+
+StreamingZProjection::StreamingZProjection(int width, int height, int maxValue, int depth,
+                                           ProjectionCriterion criterion)
+  : state_(maxValue > 255 ? makeStream<uint16_t>(width, height, maxValue, depth, criterion)
+                          : makeStream<uint8_t>(width, height, maxValue, depth, criterion)) {}
+
+StreamingZProjection::~StreamingZProjection() {}
+
+int StreamingZProjection::passes() const { return state_->passes(); }
+
+void StreamingZProjection::add(const PixelBuffer& slice, ThreadPool& pool) { state_->add(slice, pool); }
+
+void StreamingZProjection::endPass() { state_->endPass(); }
+
+void StreamingZProjection::finish(PixelBuffer& result, ThreadPool& pool) { state_->finish(result, pool); }
@@ -0,0 +1,68 @@
+#ifndef PROYECCION_H
+#define PROYECCION_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "imagen.h"
+#include "pool_hilos.h"
+
+// ————————————
+// Proyecciones 2D de un volumen.
+//
+// El criterio se resuelve una sola vez por llamada y cada combinación
+// dirección x criterio tiene su propio núcleo, especializado por tipo de
+// píxel. Todos recorren el volumen en orden de memoria (fila a fila de cada
+// corte) y acumulan filas completas, en bucles simples que el compilador
+// vectoriza. Ningún núcleo reserva memoria por píxel de salida. Las filas
+// (o cortes) de salida se reparten entre los hilos del pool.
+//————————————
+enum class ProjectionAxis { X, Y, Z };
+enum class ProjectionCriterion { Max, Min, Mean, Median };
+
+bool parseProjectionAxis(const std::string& name, ProjectionAxis& axis);
+bool parseProjectionCriterion(const std::string& name, ProjectionCriterion& criterion);
+
+// Calcula la proyección de volume y la deja en result (se reserva aquí).
+// Dimensiones del resultado: z -> ancho x alto, y -> ancho x profundidad,
+// x -> profundidad x alto.
+void projectVolume(const PixelBuffer& volume, ProjectionAxis axis,
+                   ProjectionCriterion criterion, PixelBuffer& result, ThreadPool& pool);
+
+// Calcula en un solo recorrido de volume las proyecciones de todos los
+// criterios de criteria; results[c] recibe la de criteria[c], idéntica a la
+// que daría projectVolume. Cada fila del volumen se lee de memoria una vez.
+void projectVolumeFused(const PixelBuffer& volume, ProjectionAxis axis,
+                        const std::vector<ProjectionCriterion>& criteria,
+                        std::vector<PixelBuffer>& results, ThreadPool& pool);
+
+// ————————————
+// Proyección z acumulada corte a corte, sin tener el volumen en memoria.
+//
+// Máximo, mínimo y promedio llevan un acumulador por píxel de salida y
+// necesitan una sola pasada por los cortes. La mediana se selecciona por
+// dígitos de 4 bits: en cada pasada se cuentan, por píxel, los valores que
+// coinciden con el prefijo ya fijado en 16 contadores, y se fija el dígito
+// siguiente (con cantidad par de cortes, una pasada más busca el segundo
+// valor central). La memoria es O(ancho x alto) con cualquier cantidad de
+// cortes, y el resultado es idéntico al de projectVolume en z.
+//————————————
+class StreamingZProjection {
+public:
+    // depth es la cantidad total de cortes (a lo sumo 255).
+    StreamingZProjection(int width, int height, int maxValue, int depth,
+                         ProjectionCriterion criterion);
+    ~StreamingZProjection();
+
+    int passes() const;                         // Recorridos completos de los cortes
+    void add(const PixelBuffer& slice, ThreadPool& pool);   // Siguiente corte de la pasada
+    void endPass();                             // Termina la pasada actual
+    void finish(PixelBuffer& result, ThreadPool& pool);     // Después de la última pasada
+
+    struct State;
+
+private:
+    std::unique_ptr<State> state_;
+};
+
+#endif
@@ -0,0 +1,322 @@
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "imagen.h"
+#include "pgm.h"
+#include "sistema.h"
+
+// ————————————
+// Banco de pruebas de rendimiento (make bench).
+//
+// Genera un volumen sintético reproducible (y usa también las imágenes
+// img_0*.pgm que haya en el directorio de imágenes) y mide los comandos del
+// sistema tal como los ejecuta el modo por lotes, en este orden: carga,
+// codificación y decodificación de Huffman (también con el predictor MED) y
+// segmentación de las imágenes; carga del volumen, sin y con caché; cada
+// combinación de proyeccion2D, las cuatro juntas (todos) y
+// proyeccion2D_flujo; segmentar_volumen; y el volumen comprimido (archivo
+// .hufv, carga comprimida en memoria y sus proyecciones). Cada caso se
+// repite varias veces y se guarda el mínimo y la mediana en un archivo
+// JSON, para comparar versiones.
+//
+//   rendimiento [--tam AxLxP] [--max M] [--reps N] [--hilos N]
+//               [--datos <dir>] [--imagenes <dir>] [--salida <archivo.json>]
+//————————————
+using namespace std;
+
+namespace {
+
+struct Options {
+    int width = 512, height = 512, depth = 64, maxValue = 255;
+    int reps = 5, threads = 0;
+    string dataDir = "bench_datos";
+    string imageDir = ".";
+    string output = "bench.json";
+};
+
+struct Result {
+    string name;
+    vector<double> ms;
+    size_t bytes;       // Bytes procesados por repetición (0 = no aplica)
+    double ratio;       // Compresión (0 = no aplica)
+};
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int a = 1; a < argc; ++a) {
+        string arg = argv[a];
+        if (a + 1 >= argc) return false;
+        string value = argv[++a];
+        if (arg == "--tam") {
+            char x1, x2;
+            stringstream ss(value);
+            if (!(ss >> options.width >> x1 >> options.height >> x2 >> options.depth) ||
+                x1 != 'x' || x2 != 'x')
+                return false;
+        } else if (arg == "--max") {
+            options.maxValue = atoi(value.c_str());
+        } else if (arg == "--reps") {
+            options.reps = atoi(value.c_str());
+        } else if (arg == "--hilos") {
+            options.threads = atoi(value.c_str());
+        } else if (arg == "--datos") {
+            options.dataDir = value;
+        } else if (arg == "--imagenes") {
+            options.imageDir = value;
+        } else if (arg == "--salida") {
+            options.output = value;
+        } else {
+            return false;
+        }
+    }
+    return options.width > 0 && options.height > 0 && options.depth >= 1 && options.depth <= 99 &&
+           options.maxValue >= 1 && options.maxValue <= 65535 && options.reps >= 1;
+}
+
+size_t fileSize(const string& name) {
+    struct stat st;
+    return stat(name.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+}
+
+// Volumen sintético: manchas suaves que se desplazan entre cortes más un
+// poco de ruido, para que la segmentación y Huffman tengan algo de estructura.
+bool writeSyntheticVolume(const Options& o, const string& base) {
+    uint32_t state = 12345;
+    PixelBuffer slice;
+    slice.allocate(o.width, o.height, 1, o.maxValue);
+    for (int k = 0; k < o.depth; ++k) {
+        for (int i = 0; i < o.height; ++i)
+            for (int j = 0; j < o.width; ++j) {
+                state = state * 1664525u + 1013904223u;
+                double x = double(j) / o.width, y = double(i) / o.height, z = double(k) / o.depth;
+                double dx = x - 0.3 - 0.4 * z, dy = y - 0.5, ex = x - 0.7, ey = y - 0.3 - 0.4 * z;
+                double v = 0.55 / (1.0 + 40.0 * (dx * dx + dy * dy)) + 0.35 / (1.0 + 60.0 * (ex * ex + ey * ey));
+                v += 0.1 * ((state >> 8) & 0xffff) / 65535.0;
+                slice.set(0, i, j, static_cast<int>(min(1.0, v) * o.maxValue));
+            }
+        stringstream name;
+        name << base << (k + 1 < 10 ? "0" : "") << k + 1 << ".pgm";
+        if (writePGMFile(name.str(), slice, PgmFormat::Ascii, "Volumen sintético") != PgmStatus::Ok)
+            return false;
+    }
+    return true;
+}
+
+class Bench {
+public:
+    Bench(ImageProcessingSystem& system, int reps) : system_(system), reps_(reps) {}
+
+    // Ejecuta un comando sin medirlo; false si falló.
+    bool run(const string& command) {
+        stringstream script(command);
+        output_.str("");
+        streambuf* saved = cout.rdbuf(output_.rdbuf());
+        int status = system_.runBatch(script, true);
+        cout.rdbuf(saved);
+        if (status != 0) cerr << "Falló '" << command << "':\n" << output_.str();
+        return status == 0;
+    }
+
+    // Mide command reps veces; before se ejecuta (sin medir) antes de cada una.
+    bool measure(const string& name, const string& command, size_t bytes,
+                 const function<void()>& before = function<void()>()) {
+        Result result = { name, vector<double>(), bytes, 0.0 };
+        for (int r = 0; r < reps_; ++r) {
+            if (before) before();
+            auto t0 = chrono::steady_clock::now();
+            if (!run(command)) return false;
+            chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - t0;
+            result.ms.push_back(elapsed.count());
+        }
+        sort(result.ms.begin(), result.ms.end());
+        cerr << name << ": " << result.ms.front() << " ms\n";
+        results_.push_back(result);
+        return true;
+    }
+
+    // Anota la compresión obtenida en el último caso medido.
+    void setLastRatio(double ratio) { results_.back().ratio = ratio; }
+
+    const vector<Result>& results() const { return results_; }
+
+private:
+    ImageProcessingSystem& system_;
+    int reps_;
+    ostringstream output_;
+    vector<Result> results_;
+};
+
+string jsonString(const string& s) {
+    string out = "\"";
+    for (size_t c = 0; c < s.size(); ++c) {
+        if (s[c] == '"' || s[c] == '\\') out += '\\';
+        out += s[c];
+    }
+    return out + "\"";
+}
+
+bool writeJson(const Options& o, const vector<Result>& results) {
+    ofstream out(o.output);
+    if (!out) return false;
+    time_t now = time(nullptr);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    out << "{\n"
+        << "  \"fecha\": \"" << date << "\",\n"
+        << "  \"nucleos\": " << thread::hardware_concurrency() << ",\n"
+        << "  \"hilos\": " << o.threads << ",\n"
+        << "  \"volumen\": {\"ancho\": " << o.width << ", \"alto\": " << o.height
+        << ", \"cortes\": " << o.depth << ", \"max\": " << o.maxValue << "},\n"
+        << "  \"repeticiones\": " << o.reps << ",\n"
+        << "  \"casos\": [\n";
+    for (size_t r = 0; r < results.size(); ++r) {
+        const Result& res = results[r];
+        double best = res.ms.front(), median = res.ms[res.ms.size() / 2];
+        out << "    {\"nombre\": " << jsonString(res.name) << ", \"ms_min\": " << best
+            << ", \"ms_mediana\": " << median;
+        if (res.bytes) out << ", \"mb_s\": " << res.bytes / (1024.0 * 1024.0) / (best / 1000.0);
+        if (res.ratio > 0) out << ", \"compresion\": " << res.ratio;
+        out << "}" << (r + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options o;
+    if (!parseOptions(argc, argv, o)) {
+        cerr << "Uso: rendimiento [--tam AxLxP] [--max M] [--reps N] [--hilos N]\n"
+             << "                 [--datos <dir>] [--imagenes <dir>] [--salida <archivo.json>]" << endl;
+        return 2;
+    }
+
+    mkdir(o.dataDir.c_str(), 0755);
+    const string base = o.dataDir + "/sint_";
+    const string cache = base + ".vcache";
+    cerr << "Generando volumen " << o.width << "x" << o.height << "x" << o.depth << "..." << endl;
+    if (!writeSyntheticVolume(o, base)) {
+        cerr << "Error: No se pudo escribir el volumen en " << o.dataDir << endl;
+        return 1;
+    }
+
+    ImageProcessingSystem system;
+    Bench bench(system, o.reps);
+    stringstream threads;
+    threads << "hilos " << o.threads;
+    if (!bench.run(threads.str())) return 1;
+
+    // 1. Imágenes: las incluidas en el repositorio y el primer corte sintético
+    vector<pair<string, string> > images;
+    for (int n = 1; n <= 9; ++n) {
+        string name = o.imageDir + "/img_0" + char('0' + n) + ".pgm";
+        if (fileSize(name) > 0) images.push_back(make_pair("img_0" + string(1, char('0' + n)), name));
+    }
+    images.push_back(make_pair(string("sintetica"), base + "01.pgm"));
+
+    const string huf = o.dataDir + "/imagen.huf";
+    const string decoded = o.dataDir + "/imagen.pgm";
+    for (size_t m = 0; m < images.size(); ++m) {
+        const string& tag = images[m].first;
+        const string& file = images[m].second;
+        PixelBuffer image;
+        if (readPGMFile(file, image) != PgmStatus::Ok) continue;
+        const size_t raw = static_cast<size_t>(image.width()) * image.height() * image.bytesPerPixel();
+
+        bool ok = bench.measure("cargar_imagen " + tag, "cargar_imagen " + file, fileSize(file)) &&
+                  bench.measure("codificar_imagen " + tag, "codificar_imagen " + huf, raw);
+        if (!ok) return 1;
+        bench.setLastRatio(double(raw) / max<size_t>(1, fileSize(huf)));
+        stringstream seeds;
+        seeds << "segmentar " << o.dataDir << "/segmentada.pgm "
+              << image.width() / 4 << " " << image.height() / 4 << " 1 "
+              << 3 * image.width() / 4 << " " << image.height() / 4 << " 2 "
+              << image.width() / 4 << " " << 3 * image.height() / 4 << " 3 "
+              << 3 * image.width() / 4 << " " << 3 * image.height() / 4 << " 4";
+        ok = bench.measure("decodificar_archivo " + tag, "decodificar_archivo " + huf + " " + decoded, raw) &&
+             bench.measure("segmentar " + tag, seeds.str(), 0);
+        if (!ok) return 1;
+
+        // Con predicción MED antes de Huffman
+        if (!bench.measure("codificar_imagen med " + tag, "codificar_imagen " + huf + " med", raw)) return 1;
+        bench.setLastRatio(double(raw) / max<size_t>(1, fileSize(huf)));
+        if (!bench.measure("decodificar_archivo med " + tag, "decodificar_archivo " + huf + " " + decoded, raw))
+            return 1;
+    }
+
+    // 2. Volumen: carga leyendo los cortes y desde la caché
+    stringstream load;
+    load << "cargar_volumen " << base << " " << o.depth;
+    size_t sliceBytes = 0;
+    for (int k = 1; k <= o.depth; ++k) {
+        stringstream name;
+        name << base << (k < 10 ? "0" : "") << k << ".pgm";
+        sliceBytes += fileSize(name.str());
+    }
+    if (!bench.measure("cargar_volumen", load.str(), sliceBytes, [&] { remove(cache.c_str()); }) ||
+        !bench.measure("cargar_volumen (caché)", load.str(), fileSize(cache)))
+        return 1;
+
+    // 3. Proyecciones: cada dirección x criterio, y la proyección z por flujo
+    const size_t voxels = static_cast<size_t>(o.width) * o.height * o.depth * (o.maxValue > 255 ? 2 : 1);
+    const char* axes[] = { "x", "y", "z" };
+    const char* criteria[] = { "max", "min", "prom", "med" };
+    const string projected = o.dataDir + "/proyeccion.pgm";
+    for (int a = 0; a < 3; ++a)
+        for (int c = 0; c <= 4; ++c) {
+            string args = string(axes[a]) + " " + (c < 4 ? criteria[c] : "todos");     // todos: un solo recorrido
+            if (!bench.measure("proyeccion2D " + args, "proyeccion2D " + args + " " + projected + " P5", voxels))
+                return 1;
+        }
+    for (int c = 0; c < 4; ++c) {
+        stringstream command;
+        command << "proyeccion2D_flujo " << base << " " << o.depth << " " << criteria[c] << " " << projected << " P5";
+        if (!bench.measure(string("proyeccion2D_flujo ") + criteria[c], command.str(), voxels)) return 1;
+    }
+
+    // 4. Segmentación del volumen con una semilla en cada mancha y una en el fondo
+    stringstream seeds;
+    seeds << "segmentar_volumen " << o.dataDir << "/etiquetas_ 6 "
+          << int(0.3 * o.width) << " " << o.height / 2 << " 1 1 "
+          << int(0.7 * o.width) << " " << int(0.3 * o.height) << " 1 2 "
+          << o.width - 1 << " " << o.height - 1 << " " << o.depth << " 3";
+    if (!bench.measure("segmentar_volumen", seeds.str(), voxels)) return 1;
+
+    // 5. Volumen comprimido: archivo .hufv con modelo compartido y por corte, y
+    //    proyecciones sobre el volumen cargado comprimido en memoria
+    const string hufv = o.dataDir + "/volumen.hufv";
+    const char* models[] = { "compartido", "por_corte" };
+    for (int m = 0; m < 2; ++m) {
+        if (!bench.measure(string("codificar_volumen ") + models[m],
+                           "codificar_volumen " + hufv + " med " + models[m], voxels))
+            return 1;
+        bench.setLastRatio(double(voxels) / max<size_t>(1, fileSize(hufv)));
+    }
+    if (!bench.measure("decodificar_volumen", "decodificar_volumen " + hufv + " " + o.dataDir + "/decodificado_ P5",
+                       voxels) ||
+        !bench.measure("cargar_volumen comprimido", load.str() + " comprimido", sliceBytes))
+        return 1;
+    for (int a = 0; a < 3; ++a) {
+        string args = string(axes[a]) + " med";
+        if (!bench.measure("proyeccion2D comprimido " + args, "proyeccion2D " + args + " " + projected + " P5", voxels))
+            return 1;
+    }
+
+    if (!writeJson(o, bench.results())) {
+        cerr << "Error: No se pudo escribir " << o.output << endl;
+        return 1;
+    }
+    cerr << "Resultados guardados en " << o.output << endl;
+    return 0;
+}
@@ -0,0 +1,268 @@
+#include "segmentacion.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+
+// ————————————
+// Cola de cubetas para costos enteros que no decrecen. Cada cubeta es un
+// vector que se consume en orden FIFO; las entradas de un píxel cuyo costo
+// bajó después de insertarlo quedan obsoletas y se saltan al extraerlas.
+//————————————
+class BucketQueue {
+public:
+    explicit BucketQueue(int maxCost) : buckets_(maxCost + 1), current_(0), read_(0) {}
+
+    void push(int cost, int pixel) { buckets_[cost].push_back(pixel); }
+
+    // Extrae el siguiente píxel de menor costo; false si la cola quedó vacía.
+    bool pop(int& cost, int& pixel) {
+        while (current_ < buckets_.size()) {
+            std::vector<int>& bucket = buckets_[current_];
+            if (read_ < bucket.size()) {
+                cost = static_cast<int>(current_);
+                pixel = bucket[read_++];
+                return true;
+            }
+            std::vector<int>().swap(bucket);      // Cubeta agotada: liberar su memoria
+            ++current_;
+            read_ = 0;
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::vector<int> > buckets_;
+    size_t current_;    // Cubeta que se está consumiendo
+    size_t read_;       // Próxima entrada de esa cubeta
+};
+
+template <typename T, typename C>
+void growRegions(const PixelBuffer& image, const std::vector<Seed>& seeds, PixelBuffer& labels) {
+    const int width = image.width(), height = image.height();
+    const int maxValue = image.maxValue();
+    const T* pixels = image.slice<T>(0);
+    const size_t stride = image.rowStride();
+    uint8_t* out = labels.slice<uint8_t>(0);
+
+    // Costo de cada píxel; maxValue + 1 = todavía no alcanzado
+    std::vector<C> costs(static_cast<size_t>(width) * height, static_cast<C>(maxValue + 1));
+    C* cost = costs.data();
+    BucketQueue queue(maxValue);
+
+    for (size_t s = 0; s < seeds.size(); ++s) {
+        int p = seeds[s].y * width + seeds[s].x;
+        if (cost[p] == 0) continue;                 // Semilla repetida: gana la primera
+        cost[p] = 0;
+        out[p] = static_cast<uint8_t>(seeds[s].label);
+        queue.push(0, p);
+    }
+
+    int c, p;
+    while (queue.pop(c, p)) {
+        if (cost[p] != c) continue;                 // Entrada obsoleta
+        const int i = p / width, j = p - i * width;
+        const T* center = pixels + i * stride + j;
+        const int value = *center;
+        const uint8_t label = out[p];
+
+        // Vecinos 4-conexos: el costo del camino es la mayor diferencia vista
+        int neighbors[4], count = 0;
+        const T* values[4];
+        if (i > 0) { neighbors[count] = p - width; values[count++] = center - stride; }
+        if (i + 1 < height) { neighbors[count] = p + width; values[count++] = center + stride; }
+        if (j > 0) { neighbors[count] = p - 1; values[count++] = center - 1; }
+        if (j + 1 < width) { neighbors[count] = p + 1; values[count++] = center + 1; }
+
+        for (int n = 0; n < count; ++n) {
+            const int q = neighbors[n];
+            const int next = std::max(c, std::abs(static_cast<int>(*values[n]) - value));
+            if (next < cost[q]) {
+                cost[q] = static_cast<C>(next);
+                out[q] = label;
+                queue.push(next, q);
+            }
+        }
+    }
+}
+
+// ————————————
+// Segmentación 3D por frentes
+//————————————
+struct Offset {
+    int dk, di, dj;
+};
+
+std::vector<Offset> neighborOffsets(int connectivity) {
+    std::vector<Offset> offsets;
+    for (int dk = -1; dk <= 1; ++dk)
+        for (int di = -1; di <= 1; ++di)
+            for (int dj = -1; dj <= 1; ++dj) {
+                int steps = std::abs(dk) + std::abs(di) + std::abs(dj);
+                if (steps == 0 || (connectivity == 6 && steps > 1)) continue;
+                Offset o = { dk, di, dj };
+                offsets.push_back(o);
+            }
+    return offsets;
+}
+
+// Clave de un vóxel: costo << 8 | etiqueta. K es uint16_t si el costo entra
+// en 8 bits; el valor "sin alcanzar" (todos los bits en 1) coincide entonces
+// con la peor clave posible, que da la misma etiqueta.
+template <typename T, typename K>
+class VolumeGrowth {
+public:
+    VolumeGrowth(const PixelBuffer& volume, const std::vector<Seed>& seeds, int connectivity,
+                 ThreadPool& pool)
+      : volume_(volume), pool_(pool), offsets_(neighborOffsets(connectivity)),
+        width_(volume.width()), height_(volume.height()), depth_(volume.depth()),
+        sliceSize_(static_cast<size_t>(width_) * height_), keys_(sliceSize_ * depth_),
+        buckets_(volume.maxValue() + 1), parts_(pool.size() * 4) {
+        const size_t count = keys_.size();
+        pool_.parallelFor(0, count, pool_.grainFor(count), [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v) keys_[v].store(kUnreached, std::memory_order_relaxed);
+        });
+        for (size_t s = 0; s < seeds.size(); ++s) {
+            size_t v = seeds[s].slice * sliceSize_ + static_cast<size_t>(seeds[s].y) * width_ + seeds[s].x;
+            lower(v, static_cast<K>(seeds[s].label), parts_[0]);
+        }
+        merge(buckets_[0]);
+    }
+
+    void run() {
+        std::vector<size_t> front, next;
+        for (size_t c = 0; c < buckets_.size(); ++c) {
+            front.swap(buckets_[c]);
+            std::vector<size_t>().swap(buckets_[c]);
+            // Cada vuelta procesa el frente actual; lo que queda al mismo costo forma el siguiente
+            while (!front.empty()) {
+                const size_t pieces = std::min(parts_.size(), (front.size() + kMinPart - 1) / kMinPart);
+                pool_.parallelFor(0, pieces, 1, [&](size_t begin, size_t end) {
+                    for (size_t part = begin; part < end; ++part) {
+                        size_t first = front.size() * part / pieces, last = front.size() * (part + 1) / pieces;
+                        for (size_t f = first; f < last; ++f) expand(front[f], c, parts_[part]);
+                    }
+                });
+                next.clear();
+                merge(next);
+                front.swap(next);
+            }
+        }
+    }
+
+    // Copia las etiquetas a labels (un byte por vóxel).
+    void labels(PixelBuffer& out) {
+        uint8_t* dst = out.data();
+        pool_.parallelFor(0, keys_.size(), pool_.grainFor(keys_.size()), [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v)
+                dst[v] = static_cast<uint8_t>(keys_[v].load(std::memory_order_relaxed) & 0xff);
+        });
+    }
+
+private:
+    static const K kUnreached = static_cast<K>(~K(0));
+    static const size_t kMinPart = 1024;      // Vóxeles mínimos por parte del frente
+
+    // Vóxeles cuya clave bajó en una parte: al mismo costo (siguen en este
+    // nivel) o a un costo mayor (van a su cubeta)
+    struct Part {
+        std::vector<size_t> same;
+        std::vector<std::pair<size_t, size_t> > later;   // (costo, vóxel)
+    };
+
+    // Baja la clave de v a key si es menor (mínimo atómico) y lo agenda.
+    void lower(size_t v, K key, Part& part) {
+        K old = keys_[v].load(std::memory_order_relaxed);
+        while (key < old) {
+            if (keys_[v].compare_exchange_weak(old, key, std::memory_order_relaxed)) {
+                part.later.push_back(std::make_pair(static_cast<size_t>(key >> 8), v));
+                return;
+            }
+        }
+    }
+
+    void expand(size_t v, size_t c, Part& part) {
+        const K key = keys_[v].load(std::memory_order_relaxed);
+        if (key >> 8 != c) return;                // Entrada obsoleta
+        const K label = key & 0xff;
+
+        const int k = static_cast<int>(v / sliceSize_);
+        const size_t rest = v - k * sliceSize_;
+        const int i = static_cast<int>(rest / width_), j = static_cast<int>(rest - i * width_);
+        const int value = volume_.row<T>(k, i)[j];
+
+        for (size_t n = 0; n < offsets_.size(); ++n) {
+            const int nk = k + offsets_[n].dk, ni = i + offsets_[n].di, nj = j + offsets_[n].dj;
+            if (nk < 0 || nk >= depth_ || ni < 0 || ni >= height_ || nj < 0 || nj >= width_) continue;
+            const size_t u = nk * sliceSize_ + static_cast<size_t>(ni) * width_ + nj;
+            const size_t step = std::abs(static_cast<int>(volume_.row<T>(nk, ni)[nj]) - value);
+            const size_t cost = std::max(c, step);
+            const K candidate = static_cast<K>(cost << 8 | label);
+
+            K old = keys_[u].load(std::memory_order_relaxed);
+            while (candidate < old) {
+                if (keys_[u].compare_exchange_weak(old, candidate, std::memory_order_relaxed)) {
+                    if (cost == c) part.same.push_back(u);
+                    else part.later.push_back(std::make_pair(cost, u));
+                    break;
+                }
+            }
+        }
+    }
+
+    // Junta lo que dejaron las partes: same en front y later en su cubeta.
+    void merge(std::vector<size_t>& front) {
+        for (size_t p = 0; p < parts_.size(); ++p) {
+            front.insert(front.end(), parts_[p].same.begin(), parts_[p].same.end());
+            for (size_t e = 0; e < parts_[p].later.size(); ++e)
+                buckets_[parts_[p].later[e].first].push_back(parts_[p].later[e].second);
+            parts_[p].same.clear();
+            parts_[p].later.clear();
+        }
+    }
+
+    const PixelBuffer& volume_;
+    ThreadPool& pool_;
+    const std::vector<Offset> offsets_;
+    const int width_, height_, depth_;
+    const size_t sliceSize_;
+    std::vector<std::atomic<K> > keys_;
+    std::vector<std::vector<size_t> > buckets_;
+    std::vector<Part> parts_;
+};
+
+template <typename T, typename K>
+void growVolume(const PixelBuffer& volume, const std::vector<Seed>& seeds, int connectivity,
+                PixelBuffer& labels, ThreadPool& pool) {
+    VolumeGrowth<T, K> growth(volume, seeds, connectivity, pool);
+    growth.run();
+    growth.labels(labels);
+}
+
+}  // namespace
+
+void segmentRegions(const PixelBuffer& image, const std::vector<Seed>& seeds, PixelBuffer& labels) {
+    int maxLabel = 1;
+    for (size_t s = 0; s < seeds.size(); ++s) maxLabel = std::max(maxLabel, seeds[s].label);
+
+    PixelBuffer result;
+    result.allocate(image.width(), image.height(), 1, maxLabel);
+    if (!image.wide()) growRegions<uint8_t, uint16_t>(image, seeds, result);
+    else if (image.maxValue() < 65535) growRegions<uint16_t, uint16_t>(image, seeds, result);
+    else growRegions<uint16_t, int>(image, seeds, result);      // M + 1 no entra en 16 bits
+    std::swap(labels, result);
+}
+
+void segmentVolumeRegions(const PixelBuffer& volume, const std::vector<Seed>& seeds, int connectivity,
+                          PixelBuffer& labels, ThreadPool& pool) {
+    int maxLabel = 1;
+    for (size_t s = 0; s < seeds.size(); ++s) maxLabel = std::max(maxLabel, seeds[s].label);
+
+    PixelBuffer result;
+    result.allocate(volume.width(), volume.height(), volume.depth(), maxLabel);
+    if (!volume.wide()) growVolume<uint8_t, uint16_t>(volume, seeds, connectivity, result, pool);
+    else growVolume<uint16_t, uint32_t>(volume, seeds, connectivity, result, pool);
+    std::swap(labels, result);
+}
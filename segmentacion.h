@@ -0,0 +1,48 @@
+#ifndef SEGMENTACION_H
+#define SEGMENTACION_H
+
+#include <vector>
+#include "imagen.h"
+#include "pool_hilos.h"
+
+// ————————————
+// Segmentación por crecimiento de regiones desde varias semillas
+// (transformada imagen-bosque, IFT).
+//
+// El costo de un camino es la mayor diferencia de intensidad entre píxeles
+// vecinos (4-conexos) a lo largo de él, y cada píxel recibe la etiqueta de
+// la semilla que lo alcanza con el menor costo. Como los costos son enteros
+// entre 0 y M y nunca bajan al avanzar, la cola de prioridad es un arreglo
+// de M + 1 cubetas que se recorre una sola vez: insertar y extraer cuestan
+// O(1). A igual costo gana la semilla que llegó primero (y entre semillas,
+// la que aparece antes en la lista).
+//————————————
+struct Seed {
+    int x;          // Columna
+    int y;          // Fila
+    int slice;      // Corte (0 en una imagen)
+    int label;      // Etiqueta, 1..255
+};
+
+// Segmenta image (depth == 1) y deja en labels una imagen de etiquetas con
+// valor máximo igual a la mayor etiqueta. Las semillas deben estar dentro
+// de la imagen.
+void segmentRegions(const PixelBuffer& image, const std::vector<Seed>& seeds, PixelBuffer& labels);
+
+// ————————————
+// Segmentación de un volumen completo, con vecindad 6 (caras) o 26 (caras,
+// aristas y vértices) entre vóxeles.
+//
+// Mismo costo que en 2D, pero los vóxeles de cada nivel de costo se
+// procesan por frentes en paralelo: los hilos toman partes del frente y
+// bajan la clave de sus vecinos con un mínimo atómico. La clave de cada
+// vóxel empaqueta costo y etiqueta (16 bits si M <= 255), así que a igual
+// costo gana la etiqueta menor y el resultado no depende de la cantidad
+// de hilos ni del orden en que se procesen.
+//————————————
+// Segmenta volume y deja en labels un volumen de etiquetas del mismo tamaño
+// (un byte por vóxel). Las semillas deben estar dentro del volumen.
+void segmentVolumeRegions(const PixelBuffer& volume, const std::vector<Seed>& seeds, int connectivity,
+                          PixelBuffer& labels, ThreadPool& pool);
+
+#endif
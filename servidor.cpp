@@ -0,0 +1,260 @@
+#include "servidor.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <thread>
+
+namespace {
+
+volatile sig_atomic_t stopRequested = 0;
+
+void requestStop(int) { stopRequested = 1; }
+
+// Dirección de path; false si no entra en sun_path.
+bool socketAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Socket conectado a path, o -1.
+int connectTo(const sockaddr_un& address) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Sesión abierta: el hilo que la atiende avisa en done cuando termina.
+struct Connection {
+    int fd;
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool> > done;
+};
+
+void finish(Connection& connection) {
+    connection.thread.join();
+    close(connection.fd);
+}
+
+}  // namespace
+
+// ————————————
+// Candado de lectura/escritura
+//————————————
+ReadWriteLock::ReadWriteLock() { pthread_rwlock_init(&lock_, nullptr); }
+
+ReadWriteLock::~ReadWriteLock() { pthread_rwlock_destroy(&lock_); }
+
+void ReadWriteLock::lockShared() { pthread_rwlock_rdlock(&lock_); }
+
+void ReadWriteLock::lock() { pthread_rwlock_wrlock(&lock_); }
+
+void ReadWriteLock::unlock() { pthread_rwlock_unlock(&lock_); }
+
+// ————————————
+// Flujo sobre el socket
+//————————————
+SocketStreamBuf::SocketStreamBuf(int fd) : fd_(fd) {
+    setg(in_, in_, in_);
+    setp(out_, out_ + kBufferSize);
+}
+
+SocketStreamBuf::~SocketStreamBuf() { flushOutput(); }
+
+int SocketStreamBuf::underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    ssize_t n;
+    do {
+        n = recv(fd_, in_, kBufferSize, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return traits_type::eof();
+    setg(in_, in_, in_ + n);
+    return traits_type::to_int_type(*gptr());
+}
+
+int SocketStreamBuf::overflow(int c) {
+    if (!flushOutput()) return traits_type::eof();
+    if (c != traits_type::eof()) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int SocketStreamBuf::sync() { return flushOutput() ? 0 : -1; }
+
+bool SocketStreamBuf::flushOutput() {
+    // MSG_NOSIGNAL: un cliente que se fue no debe terminar el proceso con SIGPIPE
+    const char* p = pbase();
+    while (p < pptr()) {
+        ssize_t n = send(fd_, p, pptr() - p, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            setp(out_, out_ + kBufferSize);
+            return false;
+        }
+        p += n;
+    }
+    setp(out_, out_ + kBufferSize);
+    return true;
+}
+
+// ————————————
+// Servidor
+//————————————
+UnixSocketServer::UnixSocketServer() : listener_(-1) {}
+
+UnixSocketServer::~UnixSocketServer() {
+    if (listener_ < 0) return;
+    close(listener_);
+    unlink(path_.c_str());
+}
+
+ServerStatus UnixSocketServer::open(const std::string& path) {
+    sockaddr_un address;
+    if (!socketAddress(path, address)) return ServerStatus::PathTooLong;
+
+    // Un socket que quedó de un servidor anterior se reemplaza; uno que responde, no
+    int other = connectTo(address);
+    if (other >= 0) {
+        close(other);
+        return ServerStatus::InUse;
+    }
+    unlink(path.c_str());
+
+    listener_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener_ < 0) return ServerStatus::SocketError;
+    if (bind(listener_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(listener_, 64) != 0) {
+        close(listener_);
+        listener_ = -1;
+        unlink(path.c_str());
+        return ServerStatus::SocketError;
+    }
+    path_ = path;
+    return ServerStatus::Ok;
+}
+
+void UnixSocketServer::run(unsigned maxClients, const Session& session) {
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    stopRequested = 0;
+
+    std::list<Connection> connections;
+    while (!stopRequested) {
+        // Las sesiones terminadas se recogen entre conexiones
+        for (std::list<Connection>::iterator it = connections.begin(); it != connections.end();) {
+            if (*it->done) {
+                finish(*it);
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        pollfd listening = { listener_, POLLIN, 0 };
+        if (poll(&listening, 1, 200) <= 0) continue;      // Cada 200 ms se revisa la señal
+        int fd = accept(listener_, nullptr, nullptr);
+        if (fd < 0) continue;
+        if (connections.size() >= maxClients) {
+            const char busy[] = "Error: El servidor ya atiende el máximo de conexiones.\n";
+            send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+            close(fd);
+            continue;
+        }
+
+        connections.push_back(Connection());
+        Connection& connection = connections.back();
+        connection.fd = fd;
+        connection.done = std::make_shared<std::atomic<bool> >(false);
+        std::shared_ptr<std::atomic<bool> > done = connection.done;
+        connection.thread = std::thread([fd, done, &session] {
+            {
+                SocketStreamBuf buffer(fd);
+                std::istream in(&buffer);
+                std::ostream out(&buffer);
+                session(in, out);
+            }
+            shutdown(fd, SHUT_RDWR);
+            *done = true;
+        });
+    }
+
+    // Al detenerse, las sesiones ven el fin de su entrada después del comando en curso
+    for (std::list<Connection>::iterator it = connections.begin(); it != connections.end(); ++it) {
+        shutdown(it->fd, SHUT_RD);
+        finish(*it);
+    }
+}
+
+// ————————————
+// Cliente
+//————————————
+ServerStatus runSocketClient(const std::string& path, std::istream& script, bool stopOnError,
+                             std::ostream& out, int& failures) {
+    failures = 0;
+    sockaddr_un address;
+    if (!socketAddress(path, address)) return ServerStatus::PathTooLong;
+    int fd = connectTo(address);
+    if (fd < 0) return ServerStatus::SocketError;
+
+    SocketStreamBuf buffer(fd);
+    std::istream in(&buffer);
+    std::ostream requests(&buffer);
+    ServerStatus status = ServerStatus::Ok;
+    std::string command, reply;
+    while (std::getline(script, command)) {
+        size_t first = command.find_first_not_of(" \t\r");
+        if (first == std::string::npos || command[first] == '#') continue;
+        requests << command << '\n' << std::flush;
+        if (command.compare(first, std::string::npos, "salir") == 0) break;
+
+        // La respuesta termina en "estado\t<línea>\t<ok|error>\t..."
+        bool answered = false;
+        while (std::getline(in, reply)) {
+            out << reply << '\n';
+            if (reply.compare(0, 7, "estado\t") == 0) {
+                answered = true;
+                if (reply.find("\terror\t") != std::string::npos) ++failures;
+                break;
+            }
+        }
+        if (!answered) {
+            status = ServerStatus::Disconnected;
+            break;
+        }
+        if (failures > 0 && stopOnError) break;
+    }
+
+    // Al cerrar la entrada, la sesión termina las escrituras diferidas y avisa
+    // después del último estado de los archivos que no pudo escribir
+    if (status == ServerStatus::Ok) {
+        shutdown(fd, SHUT_WR);
+        while (std::getline(in, reply)) {
+            out << reply << '\n';
+            if (reply.compare(0, 6, "Error:") == 0) ++failures;
+        }
+    }
+    out.flush();
+    close(fd);
+    return status;
+}
@@ -0,0 +1,124 @@
+#ifndef SERVIDOR_H
+#define SERVIDOR_H
+
+#include <pthread.h>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+// ————————————
+// Candado de lectura/escritura sobre pthread_rwlock: muchos lectores a la
+// vez o un solo escritor. SharedLock y ExclusiveLock lo toman mientras
+// existen.
+//————————————
+class ReadWriteLock {
+public:
+    ReadWriteLock();
+    ~ReadWriteLock();
+
+    void lockShared();
+    void lock();
+    void unlock();
+
+private:
+    ReadWriteLock(const ReadWriteLock&);            // No copiable
+    ReadWriteLock& operator=(const ReadWriteLock&);
+
+    pthread_rwlock_t lock_;
+};
+
+class SharedLock {
+public:
+    explicit SharedLock(ReadWriteLock& lock) : lock_(lock) { lock_.lockShared(); }
+    ~SharedLock() { lock_.unlock(); }
+
+private:
+    SharedLock(const SharedLock&);
+    SharedLock& operator=(const SharedLock&);
+
+    ReadWriteLock& lock_;
+};
+
+class ExclusiveLock {
+public:
+    explicit ExclusiveLock(ReadWriteLock& lock) : lock_(lock) { lock_.lock(); }
+    ~ExclusiveLock() { lock_.unlock(); }
+
+private:
+    ExclusiveLock(const ExclusiveLock&);
+    ExclusiveLock& operator=(const ExclusiveLock&);
+
+    ReadWriteLock& lock_;
+};
+
+// ————————————
+// Servidor local por socket Unix.
+//
+// Cada conexión se atiende en su propio hilo con la función de sesión, que
+// recibe flujos de entrada y salida sobre el socket (con buffer; la sesión
+// decide cuándo vaciar la salida). El protocolo es el del modo por lotes:
+// el cliente manda un comando por línea y, después de la salida de cada
+// uno, llega su línea "estado". run() vuelve al recibir SIGINT o SIGTERM,
+// después de cerrar las conexiones y esperar a que terminen sus comandos.
+// El socket se crea con permisos solo para el dueño y se borra al cerrar.
+//————————————
+enum class ServerStatus {
+    Ok,
+    PathTooLong,        // La ruta no entra en sockaddr_un
+    InUse,              // Otro servidor está escuchando en la ruta
+    SocketError,        // socket, bind, listen o connect fallaron
+    Disconnected        // El servidor cerró la conexión antes de responder
+};
+
+// streambuf con buffer sobre un socket conectado.
+class SocketStreamBuf : public std::streambuf {
+public:
+    explicit SocketStreamBuf(int fd);
+    ~SocketStreamBuf();
+
+protected:
+    int underflow();
+    int overflow(int c);
+    int sync();
+
+private:
+    SocketStreamBuf(const SocketStreamBuf&);
+    SocketStreamBuf& operator=(const SocketStreamBuf&);
+
+    bool flushOutput();
+
+    static const size_t kBufferSize = 4096;
+    int fd_;
+    char in_[kBufferSize], out_[kBufferSize];
+};
+
+class UnixSocketServer {
+public:
+    typedef std::function<void(std::istream& in, std::ostream& out)> Session;
+
+    UnixSocketServer();
+    ~UnixSocketServer();                        // Cierra y borra el socket
+
+    ServerStatus open(const std::string& path);
+
+    // Atiende conexiones hasta SIGINT o SIGTERM; con maxClients sesiones
+    // abiertas, las conexiones nuevas se rechazan con un mensaje de error.
+    void run(unsigned maxClients, const Session& session);
+
+private:
+    UnixSocketServer(const UnixSocketServer&);
+    UnixSocketServer& operator=(const UnixSocketServer&);
+
+    std::string path_;
+    int listener_;
+};
+
+// Manda los comandos de script de a uno (sin líneas vacías ni comentarios)
+// y copia cada respuesta en out. failures cuenta los comandos con estado
+// "error"; con stopOnError se corta en el primero.
+ServerStatus runSocketClient(const std::string& path, std::istream& script, bool stopOnError,
+                             std::ostream& out, int& failures);
+
+#endif
@@ -2,40 +2,48 @@
 
 using namespace std;
 
-// ————————————
-// Implementación de los constructores y el comparador
-//————————————
-HuffmanNode::HuffmanNode(int s, unsigned long f)
-  : symbol(s), freq(f), left(nullptr), right(nullptr) {}
-
-bool CompareNode::operator()(HuffmanNode* a, HuffmanNode* b) const {
-    // para que la priority_queue ponga primero el de menor freq
-    return a->freq > b->freq;
-}
-
-// ————————————
-// Helper recursivo para llenar vector<string> codes
-//————————————
-void ImageProcessingSystem::buildCodes(HuffmanNode* node,
-                                       const string& prefix,
-                                       vector<string>& codes) const {
-    if (!node) return;
-    if (node->symbol >= 0)            // hoja
-        codes[node->symbol] = prefix;
-    buildCodes(node->left,  prefix + '0', codes);
-    buildCodes(node->right, prefix + '1', codes);
+namespace {
+
+// Conexión del servidor que atiende el hilo (ver serveSession): su salida
+// y su propia traza, contadores por fase y tiempo en comandos.
+struct ClientSession {
+    ostream* output;
+    ProfileCounters profile;
+    double commandSeconds;
+    bool trace;
+
+    explicit ClientSession(ostream& out) : output(&out), commandSeconds(0), trace(false) {}
+};
+
+thread_local ClientSession* currentSession = nullptr;
+
+// Contadores de la conexión actual, o los del proceso fuera del servidor.
+ProfileSnapshot commandProfile() {
+    return currentSession ? profileSnapshot(currentSession->profile) : profileSnapshot();
+}
+
+}  // namespace
+
+/**
+ * @brief Flujo de salida de los comandos: cout, o la conexión del servidor
+ * que atiende el hilo actual.
+ */
+ostream& ImageProcessingSystem::out() const {
+    return currentSession ? *currentSession->output : cout;
 }
 
 void ImageProcessingSystem::start() {
-    cout << "Bienvenido al Sistema de Procesamiento de Imágenes. Escriba 'ayuda' para ver los comandos disponibles." << endl;
+    out() << "Bienvenido al Sistema de Procesamiento de Imágenes. Escriba 'ayuda' para ver los comandos disponibles." << '\n';
     string command;
 
     while (true) {
-        cout << "$ ";
+        out() << "$ ";
         getline(cin, command);
 
         if (command == "salir") {
-            cout << "Saliendo del sistema..." << endl;
+            writer.flush();
+            reportWriteErrors();
+            out() << "Saliendo del sistema..." << '\n';
             break;
         }
 
@@ -43,7 +51,162 @@ void ImageProcessingSystem::start() {
     }
 }
 
-void ImageProcessingSystem::handleCommand(string command) {
+/**
+ * @brief Ejecuta los comandos de script, uno por línea, sin mensajes de bienvenida ni prompt.
+ *
+ * Las líneas vacías y las que empiezan con '#' se ignoran, y "salir" termina
+ * el script. Después de cada comando se imprime una línea de estado separada
+ * por tabuladores:
+ *
+ *     estado <línea> <ok|error> <milisegundos> <comando>
+ *
+ * Con stopOnError el script se detiene en el primer comando que falla.
+ * Devuelve 0 si todos los comandos terminaron bien y 1 si alguno falló.
+ */
+int ImageProcessingSystem::runBatch(istream& script, bool stopOnError) {
+    return runScript(script, stopOnError, false);
+}
+
+/**
+ * @brief Atiende una conexión del servidor: como runBatch, con la salida en
+ * output y vaciada después de cada línea de estado. Se puede llamar desde
+ * varios hilos a la vez, uno por conexión; traza y estadisticas cuentan
+ * solo los comandos de la conexión.
+ */
+int ImageProcessingSystem::serveSession(istream& input, ostream& output) {
+    ClientSession session(output);
+    currentSession = &session;
+    ProfileScope scope(&session.profile);
+    int status = runScript(input, false, true);     // Termina con writer.flush(): nada queda midiendo en session
+    currentSession = nullptr;
+    return status;
+}
+
+int ImageProcessingSystem::runScript(istream& script, bool stopOnError, bool flushEach) {
+    string command;
+    int line = 0, failures = 0;
+
+    while (getline(script, command)) {
+        ++line;
+        size_t first = command.find_first_not_of(" \t\r");
+        if (first == string::npos || command[first] == '#') continue;
+        command = command.substr(first, command.find_last_not_of(" \t\r") - first + 1);
+        if (command == "salir") break;
+
+        auto t0 = chrono::steady_clock::now();
+        bool ok = handleCommand(command);
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - t0;
+
+        out() << "estado\t" << line << '\t' << (ok ? "ok" : "error") << '\t'
+              << fixed << setprecision(3) << elapsed.count() << '\t' << command << '\n';
+        out().unsetf(ios::floatfield);
+        out() << setprecision(6);
+        if (flushEach) out().flush();
+
+        if (!ok) {
+            ++failures;
+            if (stopOnError) break;
+        }
+    }
+    writer.flush();
+    if (!reportWriteErrors()) ++failures;
+    out().flush();
+    return failures == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Ejecuta un comando y acumula su tiempo; con la traza activada
+ * muestra además el desglose por fases del comando.
+ *
+ * Los comandos que solo leen el estado (ver runsShared) corren a la vez
+ * con el candado compartido; los demás esperan a tenerlo exclusivo. La
+ * medición empieza con el candado tomado, así que la espera no cuenta.
+ */
+bool ImageProcessingSystem::handleCommand(string command) {
+    bool ok = false;
+    auto run = [&](bool exclusive) {
+        // "traza si" muestra la traza desde el próximo comando
+        const bool tracing = currentSession ? currentSession->trace : traceCommands;
+        ProfileSnapshot before = ProfileSnapshot();
+        if (tracing) before = commandProfile();
+        auto t0 = chrono::steady_clock::now();
+
+        ok = runCommand(command);
+        ok = reportWriteErrors() && ok;
+
+        // Las entradas del espacio de trabajo menos usadas dejan lugar a las activas
+        lock_guard<mutex> stats(statsMutex);
+        peakBufferBytes = max(peakBufferBytes, bufferBytes());
+        vector<string> evicted;
+        if (exclusive) evicted = workspace.evict(activeBytes());
+        for (size_t e = 0; e < evicted.size(); ++e)
+            out() << "Aviso: Se descartó de la memoria " << evicted[e] << " (límite del espacio de trabajo);"
+                  << " se volverá a cargar al usarlo." << '\n';
+
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+        (currentSession ? currentSession->commandSeconds : commandSeconds) += elapsed.count();
+        if (tracing) {
+            out() << "Traza (" << fixed << setprecision(2) << elapsed.count() * 1000.0 << " ms):" << '\n';
+            reportProfile(before, commandProfile(), elapsed.count());
+        }
+    };
+
+    bool done = false;
+    {
+        SharedLock lock(stateLock);
+        if (runsShared(command)) {
+            run(false);
+            done = true;
+        }
+    }
+    if (!done) {
+        ExclusiveLock lock(stateLock);
+        run(true);
+    }
+    return ok;
+}
+
+/**
+ * @brief true si el comando solo lee la imagen, el volumen y la configuración
+ * activos y puede correr a la vez que otros (se evalúa con el candado
+ * compartido tomado).
+ *
+ * Cargar, activar otra entrada del espacio de trabajo, construir índices y
+ * cambiar la configuración o las estadísticas necesitan el candado
+ * exclusivo; también proyeccion2D_rango y region_volumen cuando el índice
+ * que usan todavía no existe.
+ */
+bool ImageProcessingSystem::runsShared(const string& command) const {
+    stringstream ss(command);
+    string cmd, first, second, slot;
+    ss >> cmd >> first;
+    if (!first.empty() && first[0] == '@') {
+        slot = first.substr(1);
+        ss >> first;
+    }
+    ss >> second;
+
+    if (cmd == "info_imagen" || cmd == "codificar_imagen" || cmd == "segmentar")
+        return slot.empty() || slot == imageSlot;
+    if (cmd == "info_volumen" || cmd == "proyeccion2D" || cmd == "codificar_volumen" || cmd == "segmentar_volumen")
+        return slot.empty() || slot == volumeSlot;
+    if (cmd == "region_volumen")
+        return (slot.empty() || slot == volumeSlot) && (volumeData.empty() || volumeIndex.hasSums());
+    if (cmd == "proyeccion2D_rango") {
+        if (!slot.empty() && slot != volumeSlot) return false;
+        ProjectionAxis axis;
+        ProjectionCriterion criterion;
+        if (volumeData.empty() || !parseProjectionAxis(first, axis) || !parseProjectionCriterion(second, criterion) ||
+            criterion == ProjectionCriterion::Median)
+            return true;
+        return criterion == ProjectionCriterion::Mean ? volumeIndex.hasSums() : volumeIndex.hasRange(axis, criterion);
+    }
+    return cmd == "ayuda" || cmd == "proyeccion2D_flujo" || cmd == "decodificar_archivo" ||
+           cmd == "decodificar_volumen" || (cmd == "usar" && first.empty()) ||
+           (cmd == "espacio" && first.empty());
+}
+
+bool ImageProcessingSystem::runCommand(string command) {
     string cmd, param, extra;
         size_t spacePos = command.find(' ');
 
@@ -54,122 +217,422 @@ void ImageProcessingSystem::handleCommand(string command) {
             cmd = command;
         }
 
+        // Los comandos que leen archivos esperan a que terminen las escrituras diferidas
+        if (cmd == "cargar_imagen" || cmd == "cargar_volumen" || cmd == "proyeccion2D_flujo" ||
+            cmd == "decodificar_archivo" || cmd == "decodificar_volumen" || cmd == "usar" ||
+            (!param.empty() && param[0] == '@'))
+            writer.flush();
+
+        // "@nombre" como primer parámetro elige la imagen o el volumen del espacio de trabajo
+        string slot;
+        if (!param.empty() && param[0] == '@') {
+            size_t end = param.find(' ');
+            slot = param.substr(1, end == string::npos ? string::npos : end - 1);
+            end = param.find_first_not_of(' ', end);
+            param = end == string::npos ? "" : param.substr(end);
+            const bool usesImage = cmd == "info_imagen" || cmd == "codificar_imagen" || cmd == "segmentar";
+            const bool usesVolume = cmd == "info_volumen" || cmd == "proyeccion2D" || cmd == "indice_volumen" ||
+                                    cmd == "proyeccion2D_rango" || cmd == "region_volumen" ||
+                                    cmd == "codificar_volumen" || cmd == "segmentar_volumen";
+            if (slot.empty() || (!usesImage && !usesVolume && cmd != "cargar_imagen" && cmd != "cargar_volumen")) {
+                out() << "Error: El comando '" << cmd << "' no admite @<nombre>." << '\n';
+                return false;
+            }
+            if (usesImage && !selectImage(slot)) return false;
+            if (usesVolume && !selectVolume(slot)) return false;
+        }
+
         if (cmd == "ayuda") {
             showHelp(param);
         } else if (cmd == "cargar_imagen") {
-            loadImage(param);
+            return loadImage(param, slot);
         } else if (cmd == "cargar_volumen") {
-            loadVolume(param);
+            return loadVolume(param, slot);
+        } else if (cmd == "usar") {
+            return useSlot(param);
+        } else if (cmd == "espacio") {
+            return showWorkspace(param);
         } else if (cmd == "info_imagen") {
             infoImage();
         } else if (cmd == "info_volumen") {
             infoVolume();
         } else if (cmd == "proyeccion2D") {
-            projection2D(param);
+            return projection2D(param);
+        } else if (cmd == "proyeccion2D_flujo") {
+            return streamProjection(param);
+        } else if (cmd == "indice_volumen") {
+            return buildVolumeIndex(param);
+        } else if (cmd == "proyeccion2D_rango") {
+            return slabProjection(param);
+        } else if (cmd == "region_volumen") {
+            return regionStatistics(param);
         } else if (cmd == "codificar_imagen") {
-            encodeImage(param);
+            return encodeImage(param);
         } else if (cmd == "decodificar_archivo") {
-            decodeFile(param);
+            return decodeFile(param);
+        } else if (cmd == "codificar_volumen") {
+            return encodeVolume(param);
+        } else if (cmd == "decodificar_volumen") {
+            return decodeVolume(param);
         } else if (cmd == "segmentar") {
-            segmentImage(param);
+            return segmentImage(param);
+        } else if (cmd == "segmentar_volumen") {
+            return segmentVolume(param);
+        } else if (cmd == "hilos") {
+            return setThreads(param);
+        } else if (cmd == "estadisticas") {
+            return showStatistics(param);
+        } else if (cmd == "traza") {
+            return setTrace(param);
+        } else if (cmd == "escritura") {
+            return setWriteMode(param);
         } else {
-            cout << "Comando no reconocido. Escriba 'ayuda' para ver los comandos disponibles." << endl;
+            out() << "Comando no reconocido. Escriba 'ayuda' para ver los comandos disponibles." << '\n';
+            return false;
         }
+        return true;
 }
 
 void ImageProcessingSystem::showHelp(string cmd) {
      if (cmd.empty()) {
-            cout << "Comandos disponibles:\n"
-                 << "  cargar_imagen <nombre_imagen.pgm>\n"
-                 << "  cargar_volumen <nombre_base> <n_im>\n"
-                 << "  info_imagen\n"
-                 << "  info_volumen\n"
-                 << "  proyeccion2D <dirección> <criterio> <nombre_archivo.pgm>\n"
-                 << "  codificar_imagen <nombre_archivo.huf>\n"
-                 << "  decodificar_archivo <nombre_archivo.huf> <nombre_imagen.pgm>\n"
-                 << "  segmentar <salida_imagen.pgm> <sx1> <sy1> <sl1> [<sx2> <sy2> <sl2> ...]\n"
-                 << "  salir" << endl;
+            out() << "Comandos disponibles:\n"
+                  << "  cargar_imagen <nombre_imagen.pgm>\n"
+                  << "  cargar_volumen <nombre_base> <n_im> [comprimido]\n"
+                  << "  info_imagen\n"
+                  << "  info_volumen\n"
+                  << "  proyeccion2D <dirección> <criterio> <nombre_archivo.pgm> [P2|P5]\n"
+                  << "  proyeccion2D_flujo <nombre_base> <n_im> <criterio> <nombre_archivo.pgm> [P2|P5]\n"
+                  << "  indice_volumen [prom|max|min|todos]\n"
+                  << "  proyeccion2D_rango <dirección> <criterio> <inicio> <fin> <nombre_archivo.pgm> [P2|P5]\n"
+                  << "  region_volumen <x0> <x1> <y0> <y1> <z0> <z1>\n"
+                  << "  codificar_imagen <nombre_archivo.huf> [ninguno|izq|arriba|prom|med|auto]\n"
+                  << "  decodificar_archivo <nombre_archivo.huf> <nombre_imagen.pgm> [P2|P5] [filas <inicio> <fin>]\n"
+                  << "  codificar_volumen <nombre_archivo.hufv> [predictor] [compartido|por_corte]\n"
+                  << "  decodificar_volumen <nombre_archivo.hufv> <base_salida> [P2|P5]\n"
+                  << "  segmentar <salida_imagen.pgm> [P2|P5] <sx1> <sy1> <sl1> [<sx2> <sy2> <sl2> ...]\n"
+                  << "  segmentar_volumen <base_salida> [P2|P5] [6|26] <sx1> <sy1> <sz1> <sl1> [...]\n"
+                  << "  hilos [<n>]\n"
+                  << "  estadisticas [reiniciar]\n"
+                  << "  traza [si|no]\n"
+                  << "  escritura [diferida|inmediata]\n"
+                  << "  usar [<nombre>]\n"
+                  << "  espacio [limite <MB>|descartar <nombre>]\n"
+                  << "  salir\n"
+                  << "Con @<nombre> como primer parámetro, un comando usa (o carga) la imagen o el volumen\n"
+                  << "con ese nombre del espacio de trabajo; ver 'ayuda espacio'.\n"
+                  << "Modo por lotes: programa --lote <script.txt|-> [--continuar] o programa -c \"<comando>\" ...\n"
+                  << "Servidor: programa --servidor <ruta.sock>; clientes: programa --conectar <ruta.sock> --lote|-c ..." << '\n';
         } else {
             if (cmd == "cargar_imagen") {
-                cout << "Uso: cargar_imagen <nombre_imagen.pgm>\nCarga una imagen en memoria." << endl;
+                out() << "Uso: cargar_imagen <nombre_imagen.pgm>\nCarga una imagen PGM (P2 o P5) en memoria." << '\n';
             } else if (cmd == "cargar_volumen") {
-                cout << "Uso: cargar_volumen <nombre_base> <n_im>\nCarga un volumen de imágenes en memoria." << endl;
+                out() << "Uso: cargar_volumen <nombre_base> <n_im> [comprimido]\nCarga un volumen de imágenes en memoria.\n"
+                      << "Guarda una caché binaria <nombre_base>.vcache; mientras los cortes no cambien\n"
+                      << "(mismo tamaño y fecha de modificación), las cargas siguientes la usan directamente.\n"
+                      << "Con 'comprimido' cada corte queda codificado con Huffman (predictor med) y se\n"
+                      << "decodifica solo cuando se lo usa, con una caché de cortes de "
+                      << (CompressedVolume::kDefaultCacheBytes >> 20) << " MB. proyeccion2D,\n"
+                      << "info_volumen y codificar_volumen funcionan igual; los índices y la segmentación\n"
+                      << "necesitan el volumen sin comprimir." << '\n';
             } else if (cmd == "info_imagen") {
-                cout << "Uso: info_imagen\nMuestra información de la imagen cargada." << endl;
+                out() << "Uso: info_imagen\nMuestra información de la imagen cargada." << '\n';
             } else if (cmd == "info_volumen") {
-                cout << "Uso: info_volumen\nMuestra información del volumen cargado." << endl;
+                out() << "Uso: info_volumen\nMuestra información del volumen cargado." << '\n';
             } else if (cmd == "proyeccion2D") {
-                cout << "Uso: proyeccion2D <dirección> <criterio> <nombre_archivo.pgm>\nGenera una proyección 2D del volumen cargado." << endl;
+                out() << "Uso: proyeccion2D <dirección> <criterio> <nombre_archivo.pgm> [P2|P5]\nGenera una proyección 2D del volumen cargado.\nEl formato de salida por defecto es P2 (texto); P5 es binario.\n"
+                      << "Con varios criterios separados por comas (por ejemplo max,med) o 'todos', se calculan\n"
+                      << "en un solo recorrido del volumen y cada uno se guarda en <nombre>_<criterio>.pgm." << '\n';
+            } else if (cmd == "proyeccion2D_flujo") {
+                out() << "Uso: proyeccion2D_flujo <nombre_base> <n_im> <criterio> <nombre_archivo.pgm> [P2|P5]\n"
+                      << "Genera la proyección 2D en dirección z leyendo los cortes de disco de a uno,\n"
+                      << "sin cargar el volumen en memoria. La mediana necesita varias lecturas de los cortes." << '\n';
+            } else if (cmd == "indice_volumen") {
+                out() << "Uso: indice_volumen [prom|max|min|todos]\n"
+                      << "Construye índices del volumen cargado para proyeccion2D_rango y region_volumen:\n"
+                      << "sumas 3D (prom) y máximos o mínimos por bloques en las tres direcciones (max, min).\n"
+                      << "Se pueden combinar separados por comas; por defecto se construyen todos.\n"
+                      << "Se descartan al cargar otro volumen." << '\n';
+            } else if (cmd == "proyeccion2D_rango") {
+                out() << "Uso: proyeccion2D_rango <dirección> <criterio> <inicio> <fin> <nombre_archivo.pgm> [P2|P5]\n"
+                      << "Proyecta solo los cortes (z), filas (y) o columnas (x) entre inicio y fin, inclusive.\n"
+                      << "Los cortes se numeran desde 1 y las filas y columnas desde 0. Con max, min y prom cada\n"
+                      << "píxel sale del índice del volumen sin recorrer la losa; si falta, el índice se construye\n"
+                      << "en el primer uso. La mediana no usa índice." << '\n';
+            } else if (cmd == "region_volumen") {
+                out() << "Uso: region_volumen <x0> <x1> <y0> <y1> <z0> <z1>\n"
+                      << "Muestra la cantidad de vóxeles, la suma y el promedio de la región indicada\n"
+                      << "(columnas y filas desde 0, cortes desde 1, inclusive), usando el índice de sumas." << '\n';
             } else if (cmd == "codificar_imagen") {
-                cout << "Uso: codificar_imagen <nombre_archivo.huf>\nCodifica la imagen cargada usando Huffman." << endl;
+                out() << "Uso: codificar_imagen <nombre_archivo.huf> [ninguno|izq|arriba|prom|med|auto]\nCodifica la imagen cargada usando Huffman, en bloques de filas\ncon índice y sumas de verificación (CRC-32).\n"
+                      << "Con un predictor se codifica la diferencia entre cada píxel y su predicción a partir\n"
+                      << "de los vecinos (izquierda, arriba, su promedio o MED de JPEG-LS), que en imágenes\n"
+                      << "suaves ocupa menos. 'auto' elige el de menor tamaño. decodificar_archivo lo detecta solo." << '\n';
             } else if (cmd == "decodificar_archivo") {
-                cout << "Uso: decodificar_archivo <nombre_archivo.huf> <nombre_imagen.pgm>\nDecodifica un archivo de Huffman a una imagen." << endl;
+                out() << "Uso: decodificar_archivo <nombre_archivo.huf> <nombre_imagen.pgm> [P2|P5] [filas <inicio> <fin>]\nDecodifica un archivo de Huffman a una imagen.\nEl formato de salida por defecto es P2 (texto); P5 es binario.\nCon 'filas' solo se decodifican las filas indicadas (desde 0, inclusive)." << '\n';
+            } else if (cmd == "codificar_volumen") {
+                out() << "Uso: codificar_volumen <nombre_archivo.hufv> [ninguno|izq|arriba|prom|med|auto] [compartido|por_corte]\n"
+                      << "Codifica el volumen cargado en un solo archivo: un flujo Huffman por corte y un índice\n"
+                      << "para ubicar cada uno. Con 'compartido' (por defecto) todos los cortes usan un modelo\n"
+                      << "guardado una vez; con 'por_corte' cada corte lleva el suyo. El predictor por defecto es med." << '\n';
+            } else if (cmd == "decodificar_volumen") {
+                out() << "Uso: decodificar_volumen <nombre_archivo.hufv> <base_salida> [P2|P5]\n"
+                      << "Decodifica un archivo de volumen y guarda cada corte como <base_salida>01.pgm,\n"
+                      << "<base_salida>02.pgm, ... (se pueden volver a cargar con cargar_volumen)." << '\n';
             } else if (cmd == "segmentar") {
-                cout << "Uso: segmentar <salida_imagen.pgm> <sx1> <sy1> <sl1> [<sx2> <sy2> <sl2> ...]\nSegmenta la imagen cargada utilizando semillas." << endl;
+                out() << "Uso: segmentar <salida_imagen.pgm> [P2|P5] <sx1> <sy1> <sl1> [<sx2> <sy2> <sl2> ...]\nSegmenta la imagen cargada utilizando semillas (columna, fila y etiqueta entre 1 y 255).\nCada píxel toma la etiqueta de la semilla que lo alcanza con la menor diferencia de intensidad.\nEl formato de salida por defecto es P2 (texto); P5 es binario." << '\n';
+            } else if (cmd == "segmentar_volumen") {
+                out() << "Uso: segmentar_volumen <base_salida> [P2|P5] [6|26] <sx1> <sy1> <sz1> <sl1> [<sx2> <sy2> <sz2> <sl2> ...]\n"
+                      << "Segmenta el volumen cargado utilizando semillas (columna, fila, corte desde 1 y etiqueta entre 1 y 255).\n"
+                      << "La vecindad entre vóxeles es 6 (por defecto) o 26. Guarda un PGM de etiquetas por corte:\n"
+                      << "<base_salida>01.pgm, <base_salida>02.pgm, ...\n"
+                      << "El formato de salida por defecto es P2 (texto); P5 es binario." << '\n';
+            } else if (cmd == "estadisticas") {
+                out() << "Uso: estadisticas [reiniciar]\n"
+                      << "Muestra el tiempo acumulado por fase (lectura de cabeceras, decodificación, proyección,\n"
+                      << "Huffman, escritura...), los bytes leídos y escritos y la memoria usada. 'reiniciar'\n"
+                      << "pone los contadores en cero. En el modo servidor el tiempo, las fases y los bytes son\n"
+                      << "los de la conexión; los buffers y la memoria, los de todo el proceso." << '\n';
+            } else if (cmd == "traza") {
+                out() << "Uso: traza [si|no]\n"
+                      << "Activa o desactiva el desglose por fases después de cada comando. En el modo servidor\n"
+                      << "vale solo para la conexión y cuenta solo sus comandos; los buffers y la memoria son\n"
+                      << "los de todo el proceso." << '\n';
+            } else if (cmd == "escritura") {
+                out() << "Uso: escritura [diferida|inmediata]\n"
+                      << "En modo diferido los PGM de salida se escriben en disco desde un hilo aparte y el\n"
+                      << "siguiente comando empieza sin esperar. Los errores de escritura se informan después." << '\n';
+            } else if (cmd == "usar") {
+                out() << "Uso: usar [<nombre>]\n"
+                      << "Activa la imagen y/o el volumen con ese nombre del espacio de trabajo; los comandos\n"
+                      << "siguientes los usan sin @<nombre>. Sin nombre muestra los activos." << '\n';
+            } else if (cmd == "espacio") {
+                out() << "Uso: espacio [limite <MB>|descartar <nombre>]\n"
+                      << "Muestra las imágenes y volúmenes cargados. Cada carga queda con el nombre del\n"
+                      << "archivo (o del nombre base del volumen), o con el de @<nombre>:\n"
+                      << "    cargar_imagen @ct img_01.pgm\n"
+                      << "    proyeccion2D @cerebro z max salida.pgm\n"
+                      << "Si lo cargado pasa del límite (por defecto " << (Workspace::kDefaultBudget >> 20)
+                      << " MB; 0 = sin límite), se descartan de la\n"
+                      << "memoria los menos usados, salvo la imagen y el volumen activos; conservan el nombre\n"
+                      << "y se vuelven a cargar de disco al usarlos. 'descartar' los quita del todo." << '\n';
+            } else if (cmd == "hilos") {
+                out() << "Uso: hilos [<n>]\nMuestra o cambia la cantidad de hilos de trabajo (0 = núcleos disponibles)." << '\n';
             } else {
-                cout << "No hay ayuda disponible para el comando '" << cmd << "'." << endl;
+                out() << "No hay ayuda disponible para el comando '" << cmd << "'." << '\n';
             }
         }
 }
 
-void ImageProcessingSystem::loadImage(string filename) {
-    if (filename.empty()) {
-        cout << "Uso incorrecto del comando. Escriba 'ayuda cargar_imagen' para más información." << endl;
-        return;
+/**
+ * @brief Traduce el resultado de una lectura PGM a los mensajes del sistema.
+ *
+ * Devuelve true si status es Ok; en otro caso muestra el error y devuelve false.
+ */
+bool ImageProcessingSystem::checkPgmStatus(const string& filename, PgmStatus status) const {
+    switch (status) {
+    case PgmStatus::Ok:
+        return true;
+    case PgmStatus::OpenError:
+        out() << "La imagen " << filename << " no ha podido ser cargada." << '\n';
+        break;
+    case PgmStatus::BadFormat:
+        out() << "Error: El archivo no está en formato PGM (P2 o P5)." << '\n';
+        break;
+    case PgmStatus::BadHeader:
+        out() << "Error: Formato PGM inválido." << '\n';
+        break;
+    case PgmStatus::CorruptData:
+    case PgmStatus::WriteError:
+        out() << "Error: Datos de imagen corruptos." << '\n';
+        break;
     }
+    return false;
+}
 
-    ifstream file(filename);
-    if (!file) {
-        cout << "La imagen " << filename << " no ha podido ser cargada." << endl;
-        return;
+/**
+ * @brief Traduce el resultado de una operación sobre un archivo .huf a los mensajes del sistema.
+ *
+ * Devuelve true si status es Ok; en otro caso muestra el error y devuelve false.
+ */
+bool ImageProcessingSystem::checkHufStatus(const string& filename, HufStatus status) const {
+    switch (status) {
+    case HufStatus::Ok:
+        return true;
+    case HufStatus::OpenError:
+    case HufStatus::Corrupt:
+        out() << "El archivo " << filename << " no ha podido ser decodificado." << '\n';
+        break;
+    case HufStatus::BadRange:
+        out() << "Error: El rango de filas está fuera de la imagen." << '\n';
+        break;
+    case HufStatus::WriteError:
+        out() << "Error: No se pudo crear el archivo " << filename << '\n';
+        break;
     }
+    return false;
+}
+
+/**
+ * @brief Lee un archivo PGM (P2 o P5) en un buffer de píxeles.
+ *
+ * La cabecera y los datos se validan en pgm.cpp. Devuelve false si algo
+ * falla; en ese caso image queda sin modificar. Si bytesRead no es nulo,
+ * suma el tamaño del archivo leído.
+ */
+bool ImageProcessingSystem::readPGM(const string& filename, PixelBuffer& image, size_t* bytesRead) {
+    size_t bytes = 0;
+    PgmStatus status = readPGMFile(filename, image, &bytes);
+    if (bytesRead) *bytesRead += bytes;
+    return checkPgmStatus(filename, status);
+}
 
-    string format;
-    file >> format;
-    if (format != "P2") {
-        cout << "Error: El archivo no está en formato PGM (P2)." << endl;
-        return;
+/**
+ * @brief Interpreta el formato de salida opcional de los comandos que escriben PGM.
+ *
+ * Un nombre vacío equivale a P2 (texto). Muestra un error si no es P2 ni P5.
+ */
+bool ImageProcessingSystem::parseOutputFormat(const string& name, PgmFormat& format) const {
+    if (name.empty() || name == "P2" || name == "p2") {
+        format = PgmFormat::Ascii;
+    } else if (name == "P5" || name == "p5") {
+        format = PgmFormat::Binary;
+    } else {
+        out() << "Error: Formato de salida no válido. Use 'P2' o 'P5'." << '\n';
+        return false;
     }
+    return true;
+}
 
-    // Leer width, height y maxPixelValue, ignorando comentarios
-    width = height = maxPixelValue = -1;
-    string line;
-    while (getline(file, line)) {
-        if (line.empty() || line[0] == '#') continue;  // Saltar líneas vacías y comentarios
+/**
+ * @brief Formato opcional que sigue al nombre de salida en los comandos con
+ * una cantidad variable de números después (segmentar, segmentar_volumen):
+ * si la siguiente palabra de args no empieza como un número, es el formato.
+ */
+bool ImageProcessingSystem::takeOutputFormat(istream& args, PgmFormat& format) const {
+    string name;
+    args >> ws;
+    if (args.peek() != EOF && !isdigit(args.peek()) && args.peek() != '-' && args.peek() != '+') args >> name;
+    return parseOutputFormat(name, format);
+}
 
-        stringstream ss(line);
-        if (width == -1) {
-            ss >> width >> height;  // Leer dimensiones
-        } else {
-            ss >> maxPixelValue;  // Leer valor máximo de píxel
-            break;  // Una vez leído, salimos del bucle
-        }
-    }
+/**
+ * @brief Muestra cuántos bytes se leyeron y a qué velocidad.
+ */
+void ImageProcessingSystem::reportThroughput(size_t bytes, double seconds) const {
+    double mb = bytes / (1024.0 * 1024.0);
+    out() << fixed << setprecision(2)
+          << "Lectura: " << mb << " MB en " << seconds * 1000.0 << " ms ("
+          << (seconds > 0 ? mb / seconds : 0.0) << " MB/s)." << '\n';
+    out().unsetf(ios::floatfield);
+    out() << setprecision(6);
+}
 
-    if (width <= 0 || height <= 0 || maxPixelValue <= 0 || maxPixelValue > 255) {
-        cout << "Error: Formato PGM inválido." << endl;
-        return;
+/**
+ * @brief Carga una imagen PGM como la imagen activa, con el nombre name del
+ * espacio de trabajo (el del archivo si está vacío).
+ *
+ * La imagen activa anterior queda guardada con su nombre; si tenía el mismo
+ * nombre, se reemplaza. Si la lectura falla, nada cambia.
+ */
+bool ImageProcessingSystem::loadImage(string filename, const string& name) {
+    if (filename.empty()) {
+        out() << "Uso incorrecto del comando. Escriba 'ayuda cargar_imagen' para más información." << '\n';
+        return false;
     }
 
-    // Leer los datos de la imagen
-    imageData.assign(height, vector<int>(width));
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            if (!(file >> imageData[i][j]) || imageData[i][j] < 0 || imageData[i][j] > maxPixelValue) {
-                cout << "Error: Datos de imagen corruptos." << endl;
-                return;
-            }
+    size_t bytes = 0;
+    auto t0 = chrono::steady_clock::now();
+    PixelBuffer image;
+    if (!readPGM(filename, image, &bytes)) return false;
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+
+    parkImage();
+    const string slotName = name.empty() ? filename : name;
+    ImageSlot& slot = workspace.image(slotName);
+    slot.filename = filename;
+    slot.release();
+    workspace.touch(slot);
+    swap(imageData, image);
+    imageFilename = filename;
+    imageSlot = slotName;
+    out() << "La imagen " << filename << " ha sido cargada"
+          << (slotName != filename ? " como " + slotName : string()) << "." << '\n';
+    reportThroughput(bytes, elapsed.count());
+    return true;
+}
+
+/**
+ * @brief Nombre del corte index (desde 1) de un volumen: "nombre_baseXX.pgm".
+ */
+string ImageProcessingSystem::sliceFileName(const string& base, int index) const {
+    stringstream ss;
+    ss << base << (index < 10 ? "0" : "") << index << ".pgm";
+    return ss.str();
+}
+
+/**
+ * @brief Abre los cortes <base>01.pgm ... <base>NN.pgm y lee sus cabeceras.
+ *
+ * Los archivos quedan proyectados en files.mapped. Si alguno no se puede
+ * leer se muestra el error y devuelve false.
+ */
+bool ImageProcessingSystem::openVolumeFiles(const string& base, int count, VolumeFiles& files) {
+    PhaseTimer timer(Phase::HeaderScan);
+    files.names.assign(count, string());
+    files.mapped = vector<MappedFile>(count);
+    files.headers.assign(count, PgmHeader());
+    files.maxWidth = files.maxHeight = files.maxValue = -1;
+    files.bytes = 0;
+
+    for (int i = 1; i <= count; i++) {
+        files.names[i - 1] = sliceFileName(base, i);
+
+        PgmStatus status = files.mapped[i - 1].open(files.names[i - 1]) ? PgmStatus::Ok : PgmStatus::OpenError;
+        if (status == PgmStatus::Ok)
+            status = parsePGMHeader(files.mapped[i - 1].data(), files.mapped[i - 1].size(), files.headers[i - 1]);
+
+        // Si la imagen no se pudo leer, se muestra un mensaje de error y se detiene la carga
+        if (!checkPgmStatus(files.names[i - 1], status)) {
+            out() << "Error: No se pudo cargar " << files.names[i - 1] << '\n';
+            return false;
         }
+
+        // Actualizar las dimensiones máximas encontradas
+        files.maxWidth = max(files.maxWidth, files.headers[i - 1].width);
+        files.maxHeight = max(files.maxHeight, files.headers[i - 1].height);
+        files.maxValue = max(files.maxValue, files.headers[i - 1].maxValue);
+        files.bytes += files.mapped[i - 1].size();
     }
+    return true;
+}
 
-    imageFilename = filename;
-    cout << "La imagen " << filename << " ha sido cargada." << endl;
+/**
+ * @brief Interpreta "<nombre_base> <n_im>" con 1 <= n_im <= 99.
+ */
+bool ImageProcessingSystem::parseVolumeArgs(const string& baseName, const string& countText,
+                                            int& count) const {
+    if (baseName.empty() || countText.empty()) {
+        out() << "Uso incorrecto del comando. Escriba 'ayuda cargar_volumen' para más información." << '\n';
+        return false;
+    }
+    try {
+        count = stoi(countText);  // Convertir el número de imágenes a entero
+    } catch (exception &e) {
+        out() << "Error: Número de imágenes no válido." << '\n';
+        return false;
+    }
+    if (count < 1 || count > 99) {
+        out() << "Error: La cantidad de imágenes debe estar entre 1 y 99." << '\n';
+        return false;
+    }
+    return true;
 }
 
 /**
  * @brief Carga un volumen de imágenes en formato PGM y las redimensiona al tamaño de la imagen más grande.
  *
  * @param param Nombre base de las imágenes seguido de la cantidad de imágenes a cargar.
+ * @param name  Nombre del volumen en el espacio de trabajo (el nombre base si está vacío).
  *
  * Ejemplo de uso:
  *     cargar_volumen imagen 10
@@ -177,392 +640,1182 @@ void ImageProcessingSystem::loadImage(string filename) {
  * Esto intentará cargar las imágenes: imagen01.pgm, imagen02.pgm, ..., imagen10.pgm
  */
 
-void ImageProcessingSystem::loadVolume(string param) {
-    // Buscar la posición del primer espacio en la cadena
-    size_t spacePos = param.find(' ');
-    if (spacePos == string::npos) {
-        cout << "Uso incorrecto del comando. Escriba 'ayuda cargar_volumen' para más información." << endl;
-        return;
+bool ImageProcessingSystem::loadVolume(string param, const string& name) {
+    // Separar el nombre base de las imágenes, la cantidad a cargar y el modo
+    stringstream ss(param);
+    string base, numStr, mode, extra;
+    ss >> base >> numStr >> mode >> extra;
+    if (base.empty() || numStr.empty() || !extra.empty() || (!mode.empty() && mode != "comprimido")) {
+        out() << "Uso incorrecto del comando. Escriba 'ayuda cargar_volumen' para más información." << '\n';
+        return false;
     }
 
-    // Separar el nombre base de las imágenes y la cantidad de imágenes a cargar
-    string base = param.substr(0, spacePos);
-    string numStr = param.substr(spacePos + 1);
-
+    // Validar el número de imágenes (entre 1 y 99)
     int num_images;
-    try {
-        num_images = stoi(numStr);  // Convertir el número de imágenes a entero
-    } catch (exception &e) {
-        cout << "Error: Número de imágenes no válido." << endl;
-        return;
-    }
+    if (!parseVolumeArgs(base, numStr, num_images)) return false;
 
-    // Validar el rango del número de imágenes
-    if (num_images < 1 || num_images > 99) {
-        cout << "Error: La cantidad de imágenes debe estar entre 1 y 99." << endl;
-        return;
+    // El volumen activo queda guardado con su nombre; si tiene el mismo que
+    // el nuevo, o una entrada guardada lo tiene, se libera antes de reservar
+    const string slotName = name.empty() ? base : name;
+    if (volumeSlot != slotName) parkVolume();
+    volumeData.clear();
+    volumeIndex.clear();
+    compressedVolume.clear();
+    volume.clear();
+    volumeSlot.clear();
+    VolumeSlot& slot = workspace.volume(slotName);
+    slot.release();
+
+    if (!(mode.empty() ? loadRawVolume(base, num_images) : loadCompressedVolume(base, num_images))) {
+        if (slot.count == 0) workspace.removeVolume(slotName);     // Sin receta anterior
+        return false;
     }
+    slot.base = base;
+    slot.count = num_images;
+    slot.compressed = !mode.empty();
+    workspace.touch(slot);
+    volumeSlot = slotName;
+    return true;
+}
 
-    // Limpiar la estructura que almacenará el volumen de imágenes
-    volumeData.clear();
-    int maxWidth = -1, maxHeight = -1;  // Variables para almacenar las dimensiones máximas
+/**
+ * @brief Carga los cortes <base>01.pgm ... como el volumen activo, sin comprimir.
+ */
+bool ImageProcessingSystem::loadRawVolume(const string& base, int num_images) {
+    auto t0 = chrono::steady_clock::now();
+
+    /**
+     * Paso 0: Si los cortes no cambiaron desde la última carga, se proyecta
+     * la caché binaria <nombre_base>.vcache en lugar de volver a leerlos.
+     */
+    const string cacheName = base + ".vcache";
+    vector<string> sliceNames;
+    for (int i = 1; i <= num_images; i++) sliceNames.push_back(sliceFileName(base, i));
+    vector<SourceStamp> stamps;
+    const bool stamped = stampSources(sliceNames, stamps);
+    size_t cacheBytes = 0;
+    if (stamped && readVolumeCache(cacheName, stamps, volumeData, &cacheBytes) == CacheStatus::Ok) {
+        volume = base;
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+        out() << "El volumen " << base << " ha sido cargado con " << num_images
+              << " imágenes, todas redimensionadas a " << volumeData.width() << "x" << volumeData.height()
+              << " (desde la caché " << cacheName << ")." << '\n';
+        reportThroughput(cacheBytes, elapsed.count());
+        return true;
+    }
 
-    vector<vector<vector<int>>> tempVolumeData; // Almacenamiento temporal de las imágenes
+    /**
+     * Paso 1: Leer solo las cabeceras para conocer el tamaño máximo.
+     * Los archivos quedan proyectados en memoria para el paso 2.
+     */
+    VolumeFiles files;
+    if (!openVolumeFiles(base, num_images, files)) return false;
+    int maxWidth = files.maxWidth, maxHeight = files.maxHeight, maxValue = files.maxValue;
+    size_t bytes = files.bytes;
+    const vector<string>& filenames = files.names;
+    const vector<PgmHeader>& headers = files.headers;
 
     /**
-     * Paso 1: Determinar el tamaño máximo de las imágenes
+     * Paso 2: Decodificar cada imagen directamente en su corte del volumen,
+     * ya reservado con el tamaño máximo y relleno con ceros (negro).
+     * Los cortes se reparten entre los hilos del pool.
      */
-    for (int i = 1; i <= num_images; i++) {
-        // Generar el nombre del archivo con formato "nombre_baseXX.pgm"
-        stringstream ss;
-        ss << base << (i < 10 ? "0" : "") << i << ".pgm";
-        string filename = ss.str();
+    PhaseTimer paddingTimer(Phase::Padding);
+    PixelBuffer slices;
+    slices.allocate(maxWidth, maxHeight, num_images, maxValue);
+    vector<PgmStatus> results(num_images, PgmStatus::Ok);
+    paddingTimer.stop();
+
+    PhaseTimer parseTimer(Phase::PixelParse);
+    pool.parallelFor(0, num_images, 1, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            results[k] = parsePGMPixels(files.mapped[k].data(), files.mapped[k].size(), headers[k], slices, static_cast<int>(k));
+            files.mapped[k].close();
+        }
+    });
+    parseTimer.stop();
+    recordBytesRead(bytes);
+
+    for (int k = 0; k < num_images; k++) {
+        if (!checkPgmStatus(filenames[k], results[k])) {
+            out() << "Error: No se pudo cargar " << filenames[k] << '\n';
+            return false;
+        }
+    }
+
+    swap(volumeData, slices);
+    volume = base;
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+
+    // La próxima carga de los mismos cortes usará la caché
+    if (stamped && writeVolumeCache(cacheName, stamps, volumeData) != CacheStatus::Ok)
+        out() << "Aviso: No se pudo guardar la caché " << cacheName << '\n';
 
-        // Intentar cargar la imagen
-        loadImage(filename);
+    // Mensaje de éxito indicando la cantidad de imágenes cargadas y sus dimensiones unificadas
+    out() << "El volumen " << base << " ha sido cargado con " << num_images
+          << " imágenes, todas redimensionadas a " << maxWidth << "x" << maxHeight << "." << '\n';
+    reportThroughput(bytes, elapsed.count());
+    return true;
+}
 
-        // Si la imagen no se cargó correctamente, se muestra un mensaje de error y se detiene la carga
-        if (imageFilename.empty()) {
-            cout << "Error: No se pudo cargar " << filename << endl;
-            return;
+/**
+ * @brief Carga un volumen dejando cada corte comprimido con Huffman en memoria.
+ *
+ * Cada corte se decodifica del PGM, se rellena al tamaño máximo y se
+ * codifica enseguida (en paralelo por cortes), así que nunca está el
+ * volumen completo descomprimido. El modelo es compartido: los PGM se leen
+ * una vez para contar los símbolos y otra para codificarlos. No usa ni
+ * escribe la caché .vcache.
+ */
+bool ImageProcessingSystem::loadCompressedVolume(const string& base, int count) {
+    auto t0 = chrono::steady_clock::now();
+    VolumeFiles files;
+    if (!openVolumeFiles(base, count, files)) return false;
+
+    vector<PgmStatus> results(count, PgmStatus::Ok);
+    CompressedVolume::SliceSource source = [&](int k, PixelBuffer& slice) {
+        PhaseTimer timer(Phase::PixelParse);
+        slice.allocate(files.maxWidth, files.maxHeight, 1, files.maxValue);
+        results[k] = parsePGMPixels(files.mapped[k].data(), files.mapped[k].size(), files.headers[k], slice, 0);
+        return results[k] == PgmStatus::Ok;
+    };
+    HufStatus status = compressedVolume.encode(files.maxWidth, files.maxHeight, count, files.maxValue, source,
+                                               Predictor::Med, VolumeModel::Shared, pool);
+    recordBytesRead(2 * files.bytes);
+    for (int k = 0; k < count; k++) {
+        if (!checkPgmStatus(files.names[k], results[k])) {
+            out() << "Error: No se pudo cargar " << files.names[k] << '\n';
+            compressedVolume.clear();
+            return false;
         }
+    }
+    if (!checkHufStatus(base, status)) {
+        compressedVolume.clear();
+        return false;
+    }
 
-        // Actualizar las dimensiones máximas encontradas
-        maxWidth = max(maxWidth, width);
-        maxHeight = max(maxHeight, height);
+    volume = base;
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+    out() << "El volumen " << base << " ha sido cargado con " << count
+          << " imágenes, todas redimensionadas a " << files.maxWidth << "x" << files.maxHeight
+          << " (comprimido: " << fixed << setprecision(2) << compressedVolume.compressedBytes() / (1024.0 * 1024.0)
+          << " MB, " << compressedVolume.rawBytes() / double(max<size_t>(1, compressedVolume.compressedBytes()))
+          << ":1)." << '\n';
+    out().unsetf(ios::floatfield);
+    out() << setprecision(6);
+    reportThroughput(files.bytes, elapsed.count());
+    return true;
+}
+
+/**
+ * @brief true si hay un volumen cargado; con needsRaw, además debe estar sin comprimir.
+ *
+ * Si no se cumple muestra el error correspondiente.
+ */
+bool ImageProcessingSystem::checkVolumeLoaded(bool needsRaw) const {
+    if (!volumeData.empty() || (!needsRaw && !compressedVolume.empty())) return true;
+    if (!compressedVolume.empty())
+        out() << "Error: El volumen " << volume << " está comprimido en memoria. Cárguelo sin 'comprimido'"
+              << " para usar este comando." << '\n';
+    else
+        out() << "Error: No hay un volumen cargado en memoria." << '\n';
+    return false;
+}
+
+/**
+ * @brief Memoria de la imagen y el volumen activos (comprimido y caché de cortes incluidos) e índices.
+ */
+size_t ImageProcessingSystem::activeBytes() const {
+    return imageData.sizeInBytes() + volumeData.sizeInBytes() + volumeIndex.sizeInBytes() +
+           compressedVolume.compressedBytes() + compressedVolume.cacheBytes();
+}
+
+/**
+ * @brief Memoria de los activos más la de lo guardado en el espacio de trabajo.
+ */
+size_t ImageProcessingSystem::bufferBytes() const {
+    return activeBytes() + workspace.residentBytes();
+}
+
+/**
+ * @brief Guarda la imagen activa en su entrada del espacio de trabajo, sin copiarla.
+ */
+void ImageProcessingSystem::parkImage() {
+    if (imageSlot.empty()) return;
+    ImageSlot& slot = workspace.image(imageSlot);
+    swap(slot.data, imageData);
+    imageData.clear();
+    slot.filename = imageFilename;
+    workspace.touch(slot);
+    imageFilename.clear();
+    imageSlot.clear();
+}
 
-        // Almacenar la imagen temporalmente
-        tempVolumeData.push_back(imageData);
+/**
+ * @brief Guarda el volumen activo, con sus índices o comprimido, en su entrada del espacio de trabajo.
+ */
+void ImageProcessingSystem::parkVolume() {
+    if (volumeSlot.empty()) return;
+    VolumeSlot& slot = workspace.volume(volumeSlot);
+    swap(slot.data, volumeData);
+    slot.index.swap(volumeIndex);
+    slot.packed.swap(compressedVolume);
+    volumeData.clear();
+    volumeIndex.clear();
+    compressedVolume.clear();
+    workspace.touch(slot);
+    volume.clear();
+    volumeSlot.clear();
+}
+
+/**
+ * @brief Activa la imagen name del espacio de trabajo; si se había descartado, la vuelve a leer.
+ */
+bool ImageProcessingSystem::selectImage(const string& name) {
+    if (name == imageSlot) return true;
+    ImageSlot* slot = workspace.findImage(name);
+    if (!slot) {
+        out() << "Error: No hay una imagen llamada " << name << " en el espacio de trabajo." << '\n';
+        return false;
     }
+    if (slot->data.empty()) return loadImage(slot->filename, name);
+
+    parkImage();
+    swap(imageData, slot->data);
+    imageFilename = slot->filename;
+    imageSlot = name;
+    workspace.touch(*slot);
+    return true;
+}
 
-    /**
-     * Paso 2: Redimensionar todas las imágenes al tamaño máximo encontrado
-     */
-    volumeData.clear();  // Limpiar la estructura para almacenar las imágenes finales
+/**
+ * @brief Activa el volumen name del espacio de trabajo; si se había descartado, lo vuelve a cargar.
+ */
+bool ImageProcessingSystem::selectVolume(const string& name) {
+    if (name == volumeSlot) return true;
+    VolumeSlot* slot = workspace.findVolume(name);
+    if (!slot) {
+        out() << "Error: No hay un volumen llamado " << name << " en el espacio de trabajo." << '\n';
+        return false;
+    }
+    if (slot->sizeInBytes() == 0) {
+        stringstream param;
+        param << slot->base << " " << slot->count << (slot->compressed ? " comprimido" : "");
+        return loadVolume(param.str(), name);
+    }
 
-    for (auto &image : tempVolumeData) {
-        // Crear una nueva imagen con las dimensiones máximas, rellena con ceros (negro)
-        vector<vector<int>> resizedImage(maxHeight, vector<int>(maxWidth, 0));
+    parkVolume();
+    swap(volumeData, slot->data);
+    volumeIndex.swap(slot->index);
+    compressedVolume.swap(slot->packed);
+    volume = slot->base;
+    volumeSlot = name;
+    workspace.touch(*slot);
+    return true;
+}
 
-        // Copiar los valores de la imagen original a la nueva imagen redimensionada
-        for (size_t i = 0; i < image.size(); i++) {
-            for (size_t j = 0; j < image[i].size(); j++) {
-                resizedImage[i][j] = image[i][j];  // Copiar el valor original
-            }
-        }
+/**
+ * @brief Activa la imagen y/o el volumen con ese nombre; sin nombre muestra los activos.
+ */
+bool ImageProcessingSystem::useSlot(string param) {
+    if (param.empty()) {
+        out() << "Imagen activa: " << (imageSlot.empty() ? "ninguna" : imageSlot) << '\n';
+        out() << "Volumen activo: " << (volumeSlot.empty() ? "ninguno" : volumeSlot) << '\n';
+        return true;
+    }
+    const bool image = workspace.findImage(param) != nullptr, vol = workspace.findVolume(param) != nullptr;
+    if (!image && !vol) {
+        out() << "Error: No hay una imagen ni un volumen llamados " << param << " en el espacio de trabajo." << '\n';
+        return false;
+    }
+    if (image) {
+        if (!selectImage(param)) return false;
+        out() << "Imagen activa: " << param << '\n';
+    }
+    if (vol) {
+        if (!selectVolume(param)) return false;
+        out() << "Volumen activo: " << param << '\n';
+    }
+    return true;
+}
 
-        // Agregar la imagen redimensionada al volumen final
-        volumeData.push_back(resizedImage);
+/**
+ * @brief Lista el espacio de trabajo, cambia su límite de memoria o descarta una entrada.
+ */
+bool ImageProcessingSystem::showWorkspace(string param) {
+    stringstream ss(param);
+    string action, value, extra;
+    ss >> action >> value >> extra;
+    if (action == "limite" && !value.empty() && extra.empty()) {
+        double mb;
+        try {
+            mb = stod(value);
+        } catch (exception &e) {
+            mb = -1;
+        }
+        if (mb < 0) {
+            out() << "Error: El límite debe ser una cantidad de MB (0 = sin límite)." << '\n';
+            return false;
+        }
+        workspace.setBudget(static_cast<size_t>(mb * 1024.0 * 1024.0));
+    } else if (action == "descartar" && !value.empty() && extra.empty()) {
+        if (value == imageSlot) {
+            imageData.clear();
+            imageFilename.clear();
+            imageSlot.clear();
+        }
+        if (value == volumeSlot) {
+            volumeData.clear();
+            volumeIndex.clear();
+            compressedVolume.clear();
+            volume.clear();
+            volumeSlot.clear();
+        }
+        const bool removedImage = workspace.removeImage(value), removedVolume = workspace.removeVolume(value);
+        if (!removedImage && !removedVolume) {
+            out() << "Error: No hay una imagen ni un volumen llamados " << value << " en el espacio de trabajo." << '\n';
+            return false;
+        }
+        out() << value << " se quitó del espacio de trabajo." << '\n';
+        return true;
+    } else if (!param.empty()) {
+        out() << "Uso incorrecto del comando. Escriba 'ayuda espacio' para más información." << '\n';
+        return false;
     }
 
-    // Mensaje de éxito indicando la cantidad de imágenes cargadas y sus dimensiones unificadas
-    cout << "El volumen " << base << " ha sido cargado con " << num_images
-         << " imágenes, todas redimensionadas a " << maxWidth << "x" << maxHeight << "." << endl;
-         height = maxHeight;
-         width = maxWidth;
+    // Las entradas activas tienen sus datos en el sistema
+    const double mb = 1024.0 * 1024.0;
+    out() << fixed << setprecision(2) << "Espacio de trabajo: " << bufferBytes() / mb << " MB en memoria, límite ";
+    if (workspace.budget() == 0) out() << "ninguno";
+    else out() << workspace.budget() / mb << " MB";
+    out() << "." << '\n';
+    const map<string, ImageSlot>& images = workspace.images();
+    for (map<string, ImageSlot>::const_iterator it = images.begin(); it != images.end(); ++it) {
+        const bool active = it->first == imageSlot;
+        const size_t bytes = active ? imageData.sizeInBytes() : it->second.sizeInBytes();
+        out() << "  imagen " << it->first << " (" << it->second.filename << "): ";
+        if (active) out() << bytes / mb << " MB, activa";
+        else if (bytes > 0) out() << bytes / mb << " MB";
+        else out() << "descartada";
+        out() << '\n';
+    }
+    const map<string, VolumeSlot>& volumes = workspace.volumes();
+    for (map<string, VolumeSlot>::const_iterator it = volumes.begin(); it != volumes.end(); ++it) {
+        const bool active = it->first == volumeSlot;
+        const size_t bytes = active ? activeBytes() - imageData.sizeInBytes() : it->second.sizeInBytes();
+        out() << "  volumen " << it->first << " (" << it->second.base << " " << it->second.count
+              << (it->second.compressed ? " comprimido" : "") << "): ";
+        if (active) out() << bytes / mb << " MB, activo";
+        else if (bytes > 0) out() << bytes / mb << " MB";
+        else out() << "descartado";
+        out() << '\n';
+    }
+    if (images.empty() && volumes.empty()) out() << "  (vacío)" << '\n';
+    out().unsetf(ios::floatfield);
+    out() << setprecision(6);
+    return true;
 }
 
 void ImageProcessingSystem::infoImage() {
   if (imageFilename.empty()) {
-            cout << "No hay una imagen cargada en memoria." << endl;
+            out() << "No hay una imagen cargada en memoria." << '\n';
         } else {
-            cout << "Imagen cargada en memoria: " << imageFilename << endl;
-            cout << "Dimensiones: " << width << " x " << height << " píxeles" << endl;
-            cout << "Valor máximo de píxel: " << maxPixelValue << endl;
+            out() << "Imagen cargada en memoria: " << imageFilename << '\n';
+            out() << "Dimensiones: " << imageData.width() << " x " << imageData.height() << " píxeles" << '\n';
+            out() << "Valor máximo de píxel: " << imageData.maxValue() << '\n';
         }
 }
 void ImageProcessingSystem::infoVolume() {
-  if ( volumeData.empty()) {
-            cout << "No hay un volumen cargado en memoria." << endl;
+  if (!compressedVolume.empty()) {
+            size_t hits, misses;
+            compressedVolume.cacheCounters(hits, misses);
+            out() << "Volumen cargado en memoria: " << volume << " (comprimido)" << '\n';
+            out() << "Cantidad de imágenes: " << compressedVolume.depth() << '\n';
+            out() << "Dimensiones de cada imagen: " << compressedVolume.width() << " x " << compressedVolume.height() << " píxeles" << '\n';
+            out() << "Valor máximo de píxel: " << compressedVolume.maxValue() << '\n';
+            out() << "Memoria comprimida: " << fixed << setprecision(2)
+                  << compressedVolume.compressedBytes() / (1024.0 * 1024.0) << " MB de "
+                  << compressedVolume.rawBytes() / (1024.0 * 1024.0) << " MB" << '\n';
+            out() << "Caché de cortes: " << compressedVolume.cacheBytes() / (1024.0 * 1024.0) << " MB, "
+                  << hits << " aciertos y " << misses << " fallos" << '\n';
+            out().unsetf(ios::floatfield);
+            out() << setprecision(6);
+  } else if ( volumeData.empty()) {
+            out() << "No hay un volumen cargado en memoria." << '\n';
         } else {
-            cout << "Volumen cargado en memoria: " << volume << endl;
-            cout << "Cantidad de imágenes: " << volumeData.size() << endl;
+            out() << "Volumen cargado en memoria: " << volume << '\n';
+            out() << "Cantidad de imágenes: " << volumeData.depth() << '\n';
         if (!volumeData.empty()) {
-            cout << "Dimensiones de cada imagen: " << width << " x " << height << " píxeles" << endl;
-            cout << "Valor máximo de píxel: " << maxPixelValue << endl;
+            out() << "Dimensiones de cada imagen: " << volumeData.width() << " x " << volumeData.height() << " píxeles" << '\n';
+            out() << "Valor máximo de píxel: " << volumeData.maxValue() << '\n';
+            if (volumeIndex.sizeInBytes() > 0)
+                out() << "Memoria de los índices: " << fixed << setprecision(2)
+                      << volumeIndex.sizeInBytes() / (1024.0 * 1024.0) << " MB" << '\n';
+            out().unsetf(ios::floatfield);
+            out() << setprecision(6);
         }
         }
     }
-void ImageProcessingSystem::projection2D(string param) { 
+bool ImageProcessingSystem::projection2D(string param) { 
   stringstream ss(param);
-    string direccion, criterio, filename;
+    string direccion, criterio, filename, formatName;
 
-    ss >> direccion >> criterio >> filename;
+    ss >> direccion >> criterio >> filename >> formatName;
 
     if (direccion.empty() || criterio.empty() || filename.empty()) {
-        cout << "Uso incorrecto del comando. Escriba 'ayuda proyeccion2D' para más información." << endl;
-        return;
-    }
-
-    if (volumeData.empty()) {
-        cout << "Error: No hay un volumen cargado en memoria." << endl;
-        return;
-    }
-
-    int profundidad = volumeData.size(); // Número de imágenes en el volumen
-    vector<vector<int>> resultado;
-
-    if (direccion == "z") {  // Proyección en el eje Z (vista superior)
-        resultado.assign(height, vector<int>(width, 0));
-
-        for (int i = 0; i < height; i++) {
-            for (int j = 0; j < width; j++) {
-                vector<int> valoresZ;
-                for (int k = 0; k < profundidad; k++) {
-                    valoresZ.push_back(volumeData[k][i][j]);
-                }
-
-                if (criterio == "max") {
-                    resultado[i][j] = *max_element(valoresZ.begin(), valoresZ.end());
-                } else if (criterio == "min") {
-                    resultado[i][j] = *min_element(valoresZ.begin(), valoresZ.end());
-                } else if (criterio == "prom") {
-                    resultado[i][j] = accumulate(valoresZ.begin(), valoresZ.end(), 0) / profundidad;
-                } else if (criterio == "med") {
-                    sort(valoresZ.begin(), valoresZ.end());
-                    int n = valoresZ.size();
-                    if (n % 2 == 1) {
-                        resultado[i][j] = valoresZ[n / 2]; // Si es impar, tomamos el del centro
-                    } else {
-                        resultado[i][j] = (valoresZ[n / 2 - 1] + valoresZ[n / 2]) / 2; // Si es par, promediamos los dos del centro
-                    }
-                } else {
-                    cout << "Error: Criterio no válido. Use 'max', 'min', 'prom' o 'med'." << endl;
-                    return;
-                }
-            }
+        out() << "Uso incorrecto del comando. Escriba 'ayuda proyeccion2D' para más información." << '\n';
+        return false;
+    }
+
+    PgmFormat format;
+    if (!parseOutputFormat(formatName, format)) return false;
+
+    if (!checkVolumeLoaded(false)) return false;
+
+    ProjectionAxis axis;
+    if (!parseProjectionAxis(direccion, axis)) {
+        out() << "Error: Dirección no válida. Use 'x', 'y' o 'z'." << '\n';
+        return false;
+    }
+
+    // Varios criterios separados por comas (o "todos"): un solo recorrido del volumen
+    if (criterio == "todos") criterio = "max,min,prom,med";
+    if (criterio.find(',') != string::npos) return projectionFused(axis, criterio, filename, format);
+
+    ProjectionCriterion criterion;
+    if (!parseProjectionCriterion(criterio, criterion)) {
+        out() << "Error: Criterio no válido. Use 'max', 'min', 'prom' o 'med'." << '\n';
+        return false;
+    }
+
+    // El criterio se resuelve una vez y el núcleo recorre el volumen en orden de memoria;
+    // comprimido, los cortes se decodifican a medida que la proyección los pide
+    PixelBuffer resultado;
+    if (!compressedVolume.empty()) {
+        if (!checkHufStatus(volume, projectCompressedVolume(compressedVolume, axis, criterion, resultado, pool)))
+            return false;
+    } else {
+        PhaseTimer timer(Phase::Projection);
+        projectVolume(volumeData, axis, criterion, resultado, pool);
+    }
+
+    // Guardar la imagen proyectada en un archivo PGM
+    if (savePGM(filename, resultado, format, "Proyección 2D generada") != PgmStatus::Ok) {
+        out() << "Error: No se pudo crear el archivo " << filename << '\n';
+        return false;
+    }
+    out() << "Proyección 2D guardada en " << filename << '\n';
+    return true;
+}
+
+/**
+ * @brief Varios criterios de proyeccion2D en un solo recorrido del volumen.
+ *
+ * Cada criterio se guarda en su propio archivo: "salida.pgm" con max y med
+ * da "salida_max.pgm" y "salida_med.pgm".
+ */
+bool ImageProcessingSystem::projectionFused(ProjectionAxis axis, const string& criteriaList,
+                                            const string& filename, PgmFormat format) {
+    vector<ProjectionCriterion> criteria;
+    vector<string> names;
+    stringstream list(criteriaList);
+    string name;
+    while (getline(list, name, ',')) {
+        ProjectionCriterion criterion;
+        if (!parseProjectionCriterion(name, criterion)) {
+            out() << "Error: Criterio no válido. Use 'max', 'min', 'prom' o 'med'." << '\n';
+            return false;
         }
+        if (find(criteria.begin(), criteria.end(), criterion) != criteria.end()) continue;
+        criteria.push_back(criterion);
+        names.push_back(name);
+    }
 
-    } else if (direccion == "y") {  // Proyección en el eje Y (vista lateral)
-        resultado.assign(profundidad, vector<int>(width, 0));
-
-        for (int k = 0; k < profundidad; k++) {
-            for (int j = 0; j < width; j++) {
-                vector<int> valoresY;
-                for (int i = 0; i < height; i++) {
-                    valoresY.push_back(volumeData[k][i][j]);
-                }
-
-                if (criterio == "max") {
-                    resultado[k][j] = *max_element(valoresY.begin(), valoresY.end());
-                } else if (criterio == "min") {
-                    resultado[k][j] = *min_element(valoresY.begin(), valoresY.end());
-                } else if (criterio == "prom") {
-                    resultado[k][j] = accumulate(valoresY.begin(), valoresY.end(), 0) / height;
-                } else if (criterio == "med") {
-                    sort(valoresY.begin(), valoresY.end());
-                    int n = valoresY.size();
-                    if (n % 2 == 1) {
-                        resultado[k][j] = valoresY[n / 2]; // Si es impar, tomamos el del centro
-                    } else {
-                        resultado[k][j] = (valoresY[n / 2 - 1] + valoresY[n / 2]) / 2; // Si es par, promediamos los dos del centro
-                    }
-                } else {
-                    cout << "Error: Criterio no válido. Use 'max', 'min', 'prom' o 'med'." << endl;
-                    return;
-                }
-            }
+    // Comprimido, cada criterio recorre los cortes por su cuenta (los de la caché no se decodifican de nuevo)
+    vector<PixelBuffer> resultados(criteria.size());
+    if (!compressedVolume.empty()) {
+        for (size_t c = 0; c < criteria.size(); ++c)
+            if (!checkHufStatus(volume, projectCompressedVolume(compressedVolume, axis, criteria[c], resultados[c], pool)))
+                return false;
+    } else {
+        PhaseTimer timer(Phase::Projection);
+        projectVolumeFused(volumeData, axis, criteria, resultados, pool);
+    }
+
+    // El sufijo va antes de la extensión, si la hay
+    size_t dot = filename.rfind('.');
+    if (dot == string::npos || dot < filename.find_last_of('/') + 1) dot = filename.size();
+    for (size_t c = 0; c < criteria.size(); ++c) {
+        string outName = filename.substr(0, dot) + "_" + names[c] + filename.substr(dot);
+        if (savePGM(outName, resultados[c], format, "Proyección 2D generada") != PgmStatus::Ok) {
+            out() << "Error: No se pudo crear el archivo " << outName << '\n';
+            return false;
+        }
+        out() << "Proyección 2D guardada en " << outName << '\n';
+    }
+    return true;
+}
+
+/**
+ * @brief Construye los índices del volumen cargado que usan proyeccion2D_rango
+ * y region_volumen.
+ *
+ * prom construye la tabla de sumas 3D; max y min, la tabla por bloques de
+ * su criterio en las tres direcciones. Un índice ya construido se rehace.
+ */
+bool ImageProcessingSystem::buildVolumeIndex(string param) {
+    if (!checkVolumeLoaded(true)) return false;
+    if (param.empty() || param == "todos") param = "prom,max,min";
+
+    vector<ProjectionCriterion> criteria;
+    stringstream list(param);
+    string name;
+    while (getline(list, name, ',')) {
+        ProjectionCriterion criterion;
+        if (!parseProjectionCriterion(name, criterion) || criterion == ProjectionCriterion::Median) {
+            out() << "Error: Índice no válido. Use 'prom', 'max', 'min' o 'todos'." << '\n';
+            return false;
         }
+        if (find(criteria.begin(), criteria.end(), criterion) == criteria.end()) criteria.push_back(criterion);
+    }
 
-    } else if (direccion == "x") {  // Proyección en el eje X (vista frontal)
-        resultado.assign(height, vector<int>(profundidad, 0));
-
-        for (int i = 0; i < height; i++) {
-            for (int k = 0; k < profundidad; k++) {
-                vector<int> valoresX;
-                for (int j = 0; j < width; j++) {
-                    valoresX.push_back(volumeData[k][i][j]);
-                }
-
-                if (criterio == "max") {
-                    resultado[i][k] = *max_element(valoresX.begin(), valoresX.end());
-                } else if (criterio == "min") {
-                    resultado[i][k] = *min_element(valoresX.begin(), valoresX.end());
-                } else if (criterio == "prom") {
-                    resultado[i][k] = accumulate(valoresX.begin(), valoresX.end(), 0) / width;
-                } else if (criterio == "med") {
-                    sort(valoresX.begin(), valoresX.end());
-                    int n = valoresX.size();
-                    if (n % 2 == 1) {
-                        resultado[i][k] = valoresX[n / 2]; // Si es impar, tomamos el del centro
-                    } else {
-                        resultado[i][k] = (valoresX[n / 2 - 1] + valoresX[n / 2]) / 2; // Si es par, promediamos los dos del centro
-                    }
-                } else {
-                    cout << "Error: Criterio no válido. Use 'max', 'min', 'prom' o 'med'." << endl;
-                    return;
-                }
-            }
+    auto t0 = chrono::steady_clock::now();
+    const ProjectionAxis axes[] = { ProjectionAxis::X, ProjectionAxis::Y, ProjectionAxis::Z };
+    PhaseTimer timer(Phase::IndexBuild);
+    for (size_t c = 0; c < criteria.size(); ++c) {
+        if (criteria[c] == ProjectionCriterion::Mean) {
+            volumeIndex.buildSums(volumeData, pool);
+        } else {
+            for (int a = 0; a < 3; ++a) volumeIndex.buildRange(volumeData, axes[a], criteria[c], pool);
         }
+    }
+    timer.stop();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+
+    out() << "Índices del volumen " << volume << " construidos (" << param << "): " << fixed << setprecision(2)
+          << volumeIndex.sizeInBytes() / (1024.0 * 1024.0) << " MB en " << elapsed.count() * 1000.0 << " ms."
+          << '\n';
+    out().unsetf(ios::floatfield);
+    out() << setprecision(6);
+    return true;
+}
 
+/**
+ * @brief Proyección de una losa del volumen: solo los cortes, filas o
+ * columnas entre inicio y fin. Los cortes se numeran desde 1, como en
+ * cargar_volumen y segmentar_volumen; filas y columnas, desde 0.
+ *
+ * max, min y prom se responden desde el índice (construido aquí si falta),
+ * con un costo por píxel que no depende del grosor de la losa. La mediana
+ * copia la losa y la proyecta como proyeccion2D. El resultado es el mismo
+ * que el de proyeccion2D sobre un volumen con solo esa losa.
+ */
+bool ImageProcessingSystem::slabProjection(string param) {
+    stringstream ss(param);
+    string direccion, criterio, filename, formatName;
+    int begin, end;
+    if (!(ss >> direccion >> criterio >> begin >> end >> filename)) {
+        out() << "Uso incorrecto del comando. Escriba 'ayuda proyeccion2D_rango' para más información." << '\n';
+        return false;
+    }
+    ss >> formatName;
+
+    PgmFormat format;
+    if (!parseOutputFormat(formatName, format)) return false;
+    if (!checkVolumeLoaded(true)) return false;
+    ProjectionAxis axis;
+    if (!parseProjectionAxis(direccion, axis)) {
+        out() << "Error: Dirección no válida. Use 'x', 'y' o 'z'." << '\n';
+        return false;
+    }
+    ProjectionCriterion criterion;
+    if (!parseProjectionCriterion(criterio, criterion)) {
+        out() << "Error: Criterio no válido. Use 'max', 'min', 'prom' o 'med'." << '\n';
+        return false;
+    }
+    const int length = axis == ProjectionAxis::Z ? volumeData.depth()
+                     : axis == ProjectionAxis::Y ? volumeData.height() : volumeData.width();
+    const int firstNumber = axis == ProjectionAxis::Z ? 1 : 0;
+    const int lastNumber = length - 1 + firstNumber;
+    if (begin < firstNumber || end < begin || end > lastNumber) {
+        out() << "Error: El rango debe cumplir " << firstNumber << " <= inicio <= fin <= " << lastNumber << "." << '\n';
+        return false;
+    }
+    const int first = begin - firstNumber, last = end - firstNumber;
+
+    PixelBuffer resultado;
+    if (criterion == ProjectionCriterion::Median) {
+        PixelBuffer slab;
+        copySlab(volumeData, axis, first, last, slab);
+        PhaseTimer timer(Phase::Projection);
+        projectVolume(slab, axis, criterion, resultado, pool);
     } else {
-        cout << "Error: Dirección no válida. Use 'x', 'y' o 'z'." << endl;
-        return;
+        PhaseTimer indexTimer(Phase::IndexBuild);
+        if (criterion == ProjectionCriterion::Mean && !volumeIndex.hasSums())
+            volumeIndex.buildSums(volumeData, pool);
+        else if (criterion != ProjectionCriterion::Mean && !volumeIndex.hasRange(axis, criterion))
+            volumeIndex.buildRange(volumeData, axis, criterion, pool);
+        indexTimer.stop();
+        PhaseTimer timer(Phase::Projection);
+        volumeIndex.projectSlab(volumeData, axis, criterion, first, last, resultado, pool);
     }
 
-    // Guardar la imagen proyectada en un archivo PGM
-    ofstream file(filename);
-    if (!file) {
-        cout << "Error: No se pudo crear el archivo " << filename << endl;
-        return;
+    if (savePGM(filename, resultado, format, "Proyección 2D de una losa") != PgmStatus::Ok) {
+        out() << "Error: No se pudo crear el archivo " << filename << '\n';
+        return false;
     }
+    out() << "Proyección 2D de " << begin << " a " << end << " guardada en " << filename << '\n';
+    return true;
+}
 
-    file << "P2\n";
-    file << "# Proyección 2D generada\n";
+/**
+ * @brief Cantidad de vóxeles, suma y promedio de una región del volumen,
+ * con 8 lecturas de la tabla de sumas (construida aquí si falta). Columnas
+ * y filas desde 0; cortes desde 1, como en los demás comandos de volumen.
+ */
+bool ImageProcessingSystem::regionStatistics(string param) {
+    stringstream ss(param);
+    int x0, x1, y0, y1, z0, z1;
+    if (!(ss >> x0 >> x1 >> y0 >> y1 >> z0 >> z1)) {
+        out() << "Uso incorrecto del comando. Escriba 'ayuda region_volumen' para más información." << '\n';
+        return false;
+    }
+    if (!checkVolumeLoaded(true)) return false;
+    if (x0 < 0 || x1 < x0 || x1 >= volumeData.width() || y0 < 0 || y1 < y0 || y1 >= volumeData.height() ||
+        z0 < 1 || z1 < z0 || z1 > volumeData.depth()) {
+        out() << "Error: La región debe estar dentro del volumen (" << volumeData.width() << " x "
+              << volumeData.height() << " x " << volumeData.depth() << ") y cada inicio <= fin." << '\n';
+        return false;
+    }
 
-    if (direccion == "z") {
-        file << width << " " << height << "\n";
-    } else if (direccion == "y") {
-        file << width << " " << profundidad << "\n";
-    } else if (direccion == "x") {
-        file << profundidad << " " << height << "\n";
+    if (!volumeIndex.hasSums()) {
+        PhaseTimer timer(Phase::IndexBuild);
+        volumeIndex.buildSums(volumeData, pool);
     }
+    const uint64_t voxels = static_cast<uint64_t>(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+    const uint64_t sum = volumeIndex.boxSum(x0, x1, y0, y1, z0 - 1, z1 - 1);
+    out() << "Región [" << x0 << ", " << x1 << "] x [" << y0 << ", " << y1 << "] x [" << z0 << ", " << z1
+          << "]: " << voxels << " vóxeles, suma " << sum << ", promedio " << fixed << setprecision(2)
+          << static_cast<double>(sum) / voxels << '\n';
+    out().unsetf(ios::floatfield);
+    out() << setprecision(6);
+    return true;
+}
 
-    file << maxPixelValue << "\n";
+/**
+ * @brief Proyección z leyendo los cortes de disco de a uno, sin cargar el volumen.
+ *
+ * Un hilo lector se adelanta algunos cortes mientras se acumula el actual,
+ * así que la lectura y el cálculo se solapan. La memoria usada depende solo
+ * del tamaño de un corte. El resultado es el mismo que proyeccion2D z.
+ */
+bool ImageProcessingSystem::streamProjection(string param) {
+    stringstream ss(param);
+    string base, countText, criterionName, filename, formatName;
+    ss >> base >> countText >> criterionName >> filename >> formatName;
+    if (countText.empty()) {
+        out() << "Uso incorrecto del comando. Escriba 'ayuda proyeccion2D_flujo' para más información." << '\n';
+        return false;
+    }
 
-    for (const auto& fila : resultado) {
-        for (int pixel : fila) {
-            file << pixel << " ";
+    int count;
+    if (!parseVolumeArgs(base, countText, count)) return false;
+    ProjectionCriterion criterion;
+    if (!parseProjectionCriterion(criterionName, criterion)) {
+        out() << "Error: Criterio no válido. Use 'max', 'min', 'prom' o 'med'." << '\n';
+        return false;
+    }
+    if (filename.empty()) {
+        out() << "Error: Falta el nombre del archivo de salida." << '\n';
+        return false;
+    }
+    PgmFormat format;
+    if (!parseOutputFormat(formatName, format)) return false;
+
+    // 1. Cabeceras de todos los cortes (tamaño y valor máximo de la proyección)
+    auto t0 = chrono::steady_clock::now();
+    VolumeFiles files;
+    if (!openVolumeFiles(base, count, files)) return false;
+    for (int k = 0; k < count; ++k) files.mapped[k].close();
+
+    // 2. Una o más pasadas por los cortes, con lectura anticipada
+    StreamingZProjection projection(files.maxWidth, files.maxHeight, files.maxValue, count, criterion);
+    size_t bytes = 0;
+    for (int pass = 0; pass < projection.passes(); ++pass) {
+        SliceReader reader;
+        reader.start(files.names, files.headers, files.maxWidth, files.maxHeight, files.maxValue, 2);
+        PgmStatus status;
+        for (int k = 0; k < count; ++k) {
+            const PixelBuffer* slice = reader.next(status);
+            if (!checkPgmStatus(files.names[k], status)) {
+                out() << "Error: No se pudo cargar " << files.names[k] << '\n';
+                return false;
+            }
+            PhaseTimer timer(Phase::Projection);
+            projection.add(*slice, pool);
         }
-        file << "\n";
+        projection.endPass();
+        bytes += files.bytes;
     }
 
-    file.close();
-    cout << "Proyección 2D guardada en " << filename << endl;
+    PixelBuffer resultado;
+    PhaseTimer timer(Phase::Projection);
+    projection.finish(resultado, pool);
+    timer.stop();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+
+    if (savePGM(filename, resultado, format, "Proyección 2D generada") != PgmStatus::Ok) {
+        out() << "Error: No se pudo crear el archivo " << filename << '\n';
+        return false;
+    }
+    out() << "Proyección 2D guardada en " << filename << '\n';
+    reportThroughput(bytes, elapsed.count());
+    return true;
 }
-void ImageProcessingSystem::encodeImage(string param) {
+bool ImageProcessingSystem::encodeImage(string param) {
     if (imageFilename.empty()) {                                        // 1. Verifica si hay una imagen cargada
-        cout << "No hay una imagen cargada en memoria." << endl;
-        return;                                                        //    Si no, sale
+        out() << "No hay una imagen cargada en memoria." << '\n';
+        return false;                                                   //    Si no, sale
     }
-    string outName = param;                                             // 2. Nombre de salida (.huf)
+    stringstream ss(param);                                             // 2. Nombre de salida (.huf)
+    string outName, predictorText;                                      //    y predictor opcional
+    ss >> outName >> predictorText;
     if (outName.find(".huf") == string::npos) outName += ".huf";        //    Añade extensión si falta
+    Predictor predictor = Predictor::None;
+    if (!predictorText.empty() && !parsePredictor(predictorText, predictor)) {
+        out() << "Error: Predictor no válido. Use 'ninguno', 'izq', 'arriba', 'prom', 'med' o 'auto'." << '\n';
+        return false;
+    }
 
-    // 3. Contar frecuencias de cada nivel de gris
-    vector<unsigned long> freq(maxPixelValue + 1, 0);
-    for (int i = 0; i < height; ++i)                                    //    Recorre filas
-        for (int j = 0; j < width; ++j)                                //    y columnas
-            freq[ imageData[i][j] ]++;
-
-    // 4. Construir el árbol de Huffman
-    priority_queue<HuffmanNode*, vector<HuffmanNode*>, CompareNode> pq;
-    for (int i = 0; i <= maxPixelValue; ++i)                           //    Para cada símbolo
-        pq.push(new HuffmanNode(i, freq[i]));                         //    crea un nodo y añade
-
-    while (pq.size() > 1) {                                            //    Hasta que quede solo la raíz
-        HuffmanNode* n1 = pq.top(); pq.pop();                          // 1) Extrae nodo de menor freq
-        HuffmanNode* n2 = pq.top(); pq.pop();                          // 2) Extrae siguiente menor
-        HuffmanNode* parent = new HuffmanNode(-1, n1->freq + n2->freq);// 3) Nodo interno suma freq
-        parent->left = n1;                                             //    Hijos
-        parent->right = n2;
-        pq.push(parent);                                               // 4) Reinsertar
-    }
-    HuffmanNode* root = pq.top();
-
-    // 5. Generar códigos binarios
-    vector<string> codes(maxPixelValue + 1);
-    buildCodes(root, "", codes);                                      // Llenar vector codes
-
-    // 6. Abrir archivo binario para escritura
-    ofstream out(outName, ios::binary);
-    unsigned short w = width, h = height;
-    unsigned char m = static_cast<unsigned char>(maxPixelValue);
-    out.write(reinterpret_cast<char*>(&w), sizeof(w));                // Escribir ancho
-    out.write(reinterpret_cast<char*>(&h), sizeof(h));                // Escribir alto
-    out.put(static_cast<char>(m));                                    // Escribir M
-
-    // 7. Escribir frecuencias
-    for (int i = 0; i <= maxPixelValue; ++i)
-        out.write(reinterpret_cast<char*>(&freq[i]), sizeof(unsigned long));
-
-    // 8. Empaquetar bits y escribir datos comprimidos
-    string bitBuffer;
-    for (int i = 0; i < height; ++i)
-        for (int j = 0; j < width; ++j)
-            bitBuffer += codes[ imageData[i][j] ];                   // concatenar códigos
-
-    size_t idx = 0;
-    while (idx < bitBuffer.size()) {                                  // Hasta recorrer todo
-        unsigned char byte = 0;
-        for (int b = 0; b < 8; ++b) {
-            byte <<= 1;
-            if (idx < bitBuffer.size() && bitBuffer[idx++] == '1')
-                byte |= 1;                                           // setea bit a 1 si corresponde
-        }
-        out.put(static_cast<char>(byte));                            // escribir byte
-    }
-    out.close();                                                      // cerrar archivo
-
-    cout << "La imagen en memoria ha sido codificada exitosamente y almacenada en el archivo "
-         << outName << "." << endl;                                  // Mensaje de éxito
-    }
-void ImageProcessingSystem::decodeFile(string param) {
+    // 3. Frecuencias, códigos y bloques de filas se codifican en paralelo;
+    //    con predictor, cada fila pasa a residuos justo antes de codificarse
+    size_t bytes = 0;
+    Predictor used = predictor;
+    if (!checkHufStatus(outName, writeHufFile(outName, imageData, pool, predictor, &bytes, &used))) return false;
+
+    out() << "La imagen en memoria ha sido codificada exitosamente y almacenada en el archivo "
+          << outName << "." << '\n';                                  // Mensaje de éxito
+    if (!predictorText.empty()) {
+        out() << "Predictor: " << predictorName(used) << ", " << bytes << " bytes (" << fixed << setprecision(2)
+              << imageData.width() * double(imageData.height()) * imageData.bytesPerPixel() / max<size_t>(1, bytes)
+              << ":1)." << '\n';
+        out().unsetf(ios::floatfield);
+        out() << setprecision(6);
+    }
+    return true;
+    }
+bool ImageProcessingSystem::decodeFile(string param) {
   stringstream ss(param);
-    string inName, pgmName;
+    string inName, pgmName, token, formatName;
     ss >> inName >> pgmName;                                          // 1. Obtener nombres
 
-    ifstream in(inName, ios::binary);
-    if (!in) {                                                        // 2. Verificar apertura
-        cout << "El archivo " << inName << " no ha podido ser decodificado." << endl;
-        return;
-    }
-
-    unsigned short w, h;
-    unsigned char m;
-    in.read(reinterpret_cast<char*>(&w), sizeof(w));                  // 3. Leer ancho
-    in.read(reinterpret_cast<char*>(&h), sizeof(h));                  // 4. Leer alto
-    in.read(reinterpret_cast<char*>(&m), 1);                          // 5. Leer M
-
-    int maxVal = static_cast<int>(m);
-    vector<unsigned long> freq(maxVal + 1);
-    for (int i = 0; i <= maxVal; ++i)
-        in.read(reinterpret_cast<char*>(&freq[i]), sizeof(unsigned long)); // 6. Leer frecuencias
-
-    // 7. Reconstruir árbol de Huffman (similar a encode)
-    priority_queue<HuffmanNode*, vector<HuffmanNode*>, CompareNode> pq;
-    for (int i = 0; i <= maxVal; ++i)
-        pq.push(new HuffmanNode(i, freq[i]));
-    while (pq.size() > 1) {
-        HuffmanNode* n1 = pq.top(); pq.pop();
-        HuffmanNode* n2 = pq.top(); pq.pop();
-        HuffmanNode* parent = new HuffmanNode(-1, n1->freq + n2->freq);
-        parent->left = n1; parent->right = n2;
-        pq.push(parent);
-    }
-    HuffmanNode* root = pq.top();
-
-    // 8. Leer el resto como bytes y decodificar
-    vector<vector<int>> img(h, vector<int>(w));
-    HuffmanNode* node = root;
-    int i = 0, j = 0;
-    char byte;
-    while (in.get(byte)) {
-        for (int b = 7; b >= 0; --b) {                                // leer bit a bit
-            bool bit = (byte >> b) & 1;
-            node = bit ? node->right : node->left;                   // seguir en el árbol
-            if (node->symbol >= 0) {                                 // si es hoja
-                img[i][j++] = node->symbol;
-                node = root;                                         // volver a raíz
-                if (j == w) { j = 0; if (++i == h) break; }         // siguiente pixel/fila
+    // 2. Opciones: formato de salida y rango de filas (inclusive, desde 0)
+    int firstRow = 0, lastRow = -1;
+    while (ss >> token) {
+        if (token == "filas") {
+            if (!(ss >> firstRow >> lastRow) || firstRow < 0 || lastRow < firstRow) {
+                out() << "Error: El rango de filas debe ser 'filas <inicio> <fin>' con 0 <= inicio <= fin." << '\n';
+                return false;
             }
+        } else {
+            formatName = token;
+        }
+    }
+    PgmFormat format;
+    if (!parseOutputFormat(formatName, format)) return false;
+
+    // 3. Decodificar solo los bloques que cubren las filas pedidas
+    PixelBuffer img;
+    int rowEnd = lastRow < 0 ? -1 : lastRow + 1;
+    if (!checkHufStatus(inName, readHufFile(inName, img, pool, firstRow, rowEnd))) return false;
+
+    // 4. Escribir PGM resultante
+    if (savePGM(pgmName, img, format) != PgmStatus::Ok) {
+        out() << "Error: No se pudo crear el archivo " << pgmName << '\n';
+        return false;
+    }
+
+    out() << "El archivo " << inName << " ha sido decodificado exitosamente y guardado en "
+          << pgmName << "." << '\n';                                 // Éxito
+    return true;
+    }
+
+/**
+ * @brief Codifica el volumen cargado (comprimido o no) en un archivo .hufv.
+ *
+ * Cada corte es un flujo .huf independiente; con modelo compartido los
+ * cortes se recorren dos veces, una para contar los símbolos de todos y
+ * otra para codificarlos con el mismo código.
+ */
+bool ImageProcessingSystem::encodeVolume(string param) {
+    if (!checkVolumeLoaded(false)) return false;
+    stringstream ss(param);
+    string outName, token;
+    ss >> outName;
+    if (outName.empty()) {
+        out() << "Uso incorrecto del comando. Escriba 'ayuda codificar_volumen' para más información." << '\n';
+        return false;
+    }
+    if (outName.find(".hufv") == string::npos) outName += ".hufv";
+    Predictor predictor = Predictor::Med;
+    VolumeModel model = VolumeModel::Shared;
+    while (ss >> token) {
+        if (token == "compartido") model = VolumeModel::Shared;
+        else if (token == "por_corte") model = VolumeModel::PerSlice;
+        else if (!parsePredictor(token, predictor)) {
+            out() << "Error: Opción no válida: " << token << ". Use un predictor ('ninguno', 'izq', 'arriba',"
+                  << " 'prom', 'med' o 'auto') y 'compartido' o 'por_corte'." << '\n';
+            return false;
+        }
+    }
+
+    // Los cortes salen de volumeData sin copiarlos, o del volumen comprimido
+    const bool compressed = !compressedVolume.empty();
+    const int width = compressed ? compressedVolume.width() : volumeData.width();
+    const int height = compressed ? compressedVolume.height() : volumeData.height();
+    const int depth = compressed ? compressedVolume.depth() : volumeData.depth();
+    const int maxValue = compressed ? compressedVolume.maxValue() : volumeData.maxValue();
+    CompressedVolume::SliceSource source = [&](int k, PixelBuffer& slice) {
+        if (compressed) return compressedVolume.decodeSlice(k, slice, pool) == HufStatus::Ok;
+        slice.wrap(width, height, 1, maxValue, volumeData.rowStride(),
+                   volumeData.data() + k * volumeData.sliceStride() * volumeData.bytesPerPixel(), shared_ptr<void>());
+        return true;
+    };
+    CompressedVolume encoded;
+    HufStatus status = encoded.encode(width, height, depth, maxValue, source, predictor, model, pool);
+    if (status == HufStatus::Ok) status = encoded.save(outName);
+    if (!checkHufStatus(outName, status)) return false;
+
+    out() << "El volumen " << volume << " ha sido codificado exitosamente y almacenado en el archivo "
+          << outName << "." << '\n';
+    out() << "Modelo " << (model == VolumeModel::Shared ? "compartido" : "por corte") << ", "
+          << encoded.compressedBytes() << " bytes (" << fixed << setprecision(2)
+          << encoded.rawBytes() / double(max<size_t>(1, encoded.compressedBytes())) << ":1)." << '\n';
+    out().unsetf(ios::floatfield);
+    out() << setprecision(6);
+    return true;
+}
+
+/**
+ * @brief Decodifica un archivo .hufv y guarda un PGM por corte, en paralelo.
+ */
+bool ImageProcessingSystem::decodeVolume(string param) {
+    stringstream ss(param);
+    string inName, outBase, formatName;
+    ss >> inName >> outBase >> formatName;
+    if (inName.empty() || outBase.empty()) {
+        out() << "Uso incorrecto del comando. Escriba 'ayuda decodificar_volumen' para más información." << '\n';
+        return false;
+    }
+    PgmFormat format;
+    if (!parseOutputFormat(formatName, format)) return false;
+
+    CompressedVolume encoded;
+    if (!checkHufStatus(inName, encoded.load(inName))) return false;
+
+    const int depth = encoded.depth();
+    vector<string> names(depth);
+    vector<HufStatus> decoded(depth, HufStatus::Ok);
+    vector<PgmStatus> results(depth, PgmStatus::Ok);
+    pool.parallelFor(0, depth, 1, [&](size_t begin, size_t end) {
+        PixelBuffer slice;
+        for (size_t k = begin; k < end; ++k) {
+            names[k] = sliceFileName(outBase, static_cast<int>(k) + 1);
+            decoded[k] = encoded.decodeSlice(static_cast<int>(k), slice, pool);
+            if (decoded[k] == HufStatus::Ok) results[k] = savePGM(names[k], slice, format);
+        }
+    });
+    for (int k = 0; k < depth; ++k) {
+        if (!checkHufStatus(inName, decoded[k])) return false;
+        if (results[k] != PgmStatus::Ok) {
+            out() << "Error: No se pudo crear el archivo " << names[k] << '\n';
+            return false;
+        }
+    }
+    out() << "El archivo " << inName << " ha sido decodificado exitosamente y guardado en "
+          << names.front() << " a " << names.back() << "." << '\n';
+    return true;
+}
+/**
+ * @brief Segmenta la imagen cargada a partir de semillas (x, y, etiqueta).
+ *
+ * Cada píxel recibe la etiqueta de la semilla que lo alcanza por el camino
+ * con la menor diferencia de intensidad máxima; el resultado se guarda como
+ * una imagen PGM de etiquetas.
+ */
+bool ImageProcessingSystem::segmentImage(string param) {
+    if (imageFilename.empty()) {
+        out() << "No hay una imagen cargada en memoria." << '\n';
+        return false;
+    }
+
+    // 1. Nombre de salida, formato opcional y semillas en tríos x y etiqueta
+    stringstream ss(param);
+    string outName;
+    ss >> outName;
+    PgmFormat format;
+    if (!takeOutputFormat(ss, format)) return false;
+    vector<Seed> seeds;
+    Seed seed = { 0, 0, 0, 0 };
+    while (ss >> seed.x >> seed.y >> seed.label) seeds.push_back(seed);
+    if (outName.empty() || seeds.empty() || !ss.eof()) {
+        out() << "Error: Uso: segmentar <salida_imagen.pgm> [P2|P5] <sx1> <sy1> <sl1> [<sx2> <sy2> <sl2> ...]" << '\n';
+        return false;
+    }
+    for (size_t s = 0; s < seeds.size(); ++s) {
+        if (seeds[s].x < 0 || seeds[s].x >= imageData.width() ||
+            seeds[s].y < 0 || seeds[s].y >= imageData.height()) {
+            out() << "Error: La semilla (" << seeds[s].x << ", " << seeds[s].y
+                  << ") está fuera de la imagen." << '\n';
+            return false;
+        }
+        if (seeds[s].label < 1 || seeds[s].label > 255) {
+            out() << "Error: Las etiquetas deben estar entre 1 y 255." << '\n';
+            return false;
+        }
+    }
+
+    // 2. Crecimiento de regiones con cola de cubetas
+    PixelBuffer labels;
+    PhaseTimer timer(Phase::Segmentation);
+    segmentRegions(imageData, seeds, labels);
+    timer.stop();
+
+    // 3. Guardar la imagen de etiquetas
+    if (savePGM(outName, labels, format, "Segmentación") != PgmStatus::Ok) {
+        out() << "Error: No se pudo crear el archivo " << outName << '\n';
+        return false;
+    }
+    out() << "La imagen en memoria fue segmentada correctamente y almacenada en el archivo "
+          << outName << "." << '\n';
+    return true;
+}
+
+/**
+ * @brief Segmenta el volumen cargado a partir de semillas 3D (x, y, corte, etiqueta).
+ *
+ * La vecindad es 6 por defecto; si antes de las semillas se indica 26,
+ * también se consideran vecinos los vóxeles que comparten aristas o
+ * vértices. Cada corte etiquetado se guarda como <base_salida>XX.pgm,
+ * con la misma numeración que usa cargar_volumen.
+ */
+bool ImageProcessingSystem::segmentVolume(string param) {
+    if (!checkVolumeLoaded(true)) return false;
+
+    // 1. Base de salida, formato y vecindad opcionales y semillas en grupos x y corte etiqueta
+    stringstream ss(param);
+    string outBase, token;
+    ss >> outBase;
+    PgmFormat format;
+    if (!takeOutputFormat(ss, format)) return false;
+    vector<int> values;
+    bool numeric = true;
+    while (ss >> token) {
+        try {
+            size_t used;
+            values.push_back(stoi(token, &used));
+            if (used != token.size()) numeric = false;
+        } catch (exception &e) {
+            numeric = false;
+        }
+    }
+    int connectivity = 6;
+    size_t first = 0;
+    if (values.size() % 4 == 1) connectivity = values[first++];
+    if (outBase.empty() || !numeric || values.size() == first || (values.size() - first) % 4 != 0) {
+        out() << "Error: Uso: segmentar_volumen <base_salida> [P2|P5] [6|26] <sx1> <sy1> <sz1> <sl1> [...]" << '\n';
+        return false;
+    }
+    if (connectivity != 6 && connectivity != 26) {
+        out() << "Error: La vecindad debe ser 6 o 26." << '\n';
+        return false;
+    }
+
+    vector<Seed> seeds;
+    for (size_t v = first; v < values.size(); v += 4) {
+        Seed seed = { values[v], values[v + 1], values[v + 2] - 1, values[v + 3] };
+        if (seed.x < 0 || seed.x >= volumeData.width() || seed.y < 0 || seed.y >= volumeData.height() ||
+            seed.slice < 0 || seed.slice >= volumeData.depth()) {
+            out() << "Error: La semilla (" << seed.x << ", " << seed.y << ", " << seed.slice + 1
+                  << ") está fuera del volumen." << '\n';
+            return false;
         }
-        if (i == h) break;                                            // terminado
+        if (seed.label < 1 || seed.label > 255) {
+            out() << "Error: Las etiquetas deben estar entre 1 y 255." << '\n';
+            return false;
+        }
+        seeds.push_back(seed);
     }
-    in.close();                                                      // cerrar
 
-    // 9. Escribir PGM resultante
-    ofstream out(pgmName);
-    out << "P2\n" << w << " " << h << "\n" << maxVal << "\n";
-    for (auto& row : img) {
-        for (int pix : row) out << pix << " ";
-        out << "\n";
+    // 2. Crecimiento de regiones en paralelo sobre el volumen contiguo
+    PixelBuffer labels;
+    PhaseTimer timer(Phase::Segmentation);
+    segmentVolumeRegions(volumeData, seeds, connectivity, labels, pool);
+    timer.stop();
+
+    // 3. Un PGM de etiquetas por corte, escritos en paralelo
+    const int depth = labels.depth();
+    vector<string> names(depth);
+    vector<PgmStatus> results(depth, PgmStatus::Ok);
+    pool.parallelFor(0, depth, 1, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            stringstream name;
+            name << outBase << (k + 1 < 10 ? "0" : "") << k + 1 << ".pgm";
+            names[k] = name.str();
+            PixelBuffer slice;
+            slice.wrap(labels.width(), labels.height(), 1, labels.maxValue(), labels.rowStride(),
+                       labels.slice<uint8_t>(static_cast<int>(k)), shared_ptr<void>());
+            results[k] = savePGM(names[k], slice, format, "Segmentación 3D");
+        }
+    });
+    for (int k = 0; k < depth; ++k) {
+        if (results[k] != PgmStatus::Ok) {
+            out() << "Error: No se pudo crear el archivo " << names[k] << '\n';
+            return false;
+        }
     }
-    out.close();
+    out() << "El volumen en memoria fue segmentado correctamente y almacenado en los archivos "
+          << names.front() << " a " << names.back() << "." << '\n';
+    return true;
+}
 
-    cout << "El archivo " << inName << " ha sido decodificado exitosamente y guardado en "
-         << pgmName << "." << endl;                                 // Éxito
+/**
+ * @brief Muestra o cambia la cantidad de hilos del pool de trabajo.
+ *
+ * Sin parámetro muestra el tamaño actual. Con 0 se vuelve a usar la
+ * cantidad de núcleos disponibles.
+ */
+bool ImageProcessingSystem::setThreads(string param) {
+    if (!param.empty()) {
+        int threads;
+        try {
+            threads = stoi(param);
+        } catch (exception &e) {
+            threads = -1;
+        }
+        if (threads < 0 || threads > 256) {
+            out() << "Error: La cantidad de hilos debe estar entre 0 y 256." << '\n';
+            return false;
+        }
+        pool.resize(static_cast<unsigned>(threads));
+    }
+    out() << "Hilos de trabajo: " << pool.size() << '\n';
+    return true;
+}
+
+/**
+ * @brief Muestra las fases con actividad entre dos instantáneas, los bytes
+ * leídos y escritos y la memoria de los buffers y del proceso.
+ *
+ * seconds es el tiempo de los comandos medidos, usado para el throughput.
+ */
+void ImageProcessingSystem::reportProfile(const ProfileSnapshot& from, const ProfileSnapshot& to,
+                                          double seconds) const {
+    const double mb = 1024.0 * 1024.0;
+    out() << fixed << setprecision(2);
+    for (int p = 0; p < kPhaseCount; ++p) {
+        uint64_t calls = to.calls[p] - from.calls[p];
+        if (calls == 0) continue;
+        // Rellenar por caracteres y no por bytes: los nombres llevan tildes
+        string name = phaseName(static_cast<Phase>(p));
+        size_t shown = 0;
+        for (size_t c = 0; c < name.size(); ++c) shown += (static_cast<unsigned char>(name[c]) & 0xc0) != 0x80;
+        out() << "  " << name << string(shown < 28 ? 28 - shown : 0, ' ')
+              << setw(6) << calls << " x " << setw(10) << (to.nanoseconds[p] - from.nanoseconds[p]) / 1e6
+              << " ms" << '\n';
+    }
+
+    double readMb = (to.bytesRead - from.bytesRead) / mb, writtenMb = (to.bytesWritten - from.bytesWritten) / mb;
+    out() << "  Leídos: " << readMb << " MB, escritos: " << writtenMb << " MB ("
+          << (seconds > 0 ? (readMb + writtenMb) / seconds : 0.0) << " MB/s)." << '\n';
+    out() << "  Buffers: imagen " << imageData.sizeInBytes() / mb << " MB"
+          << (imageData.isWrapped() ? " (proyectada)" : "") << ", volumen " << volumeData.sizeInBytes() / mb << " MB"
+          << (volumeData.isWrapped() ? " (proyectado)" : "") << ", comprimido "
+          << (compressedVolume.compressedBytes() + compressedVolume.cacheBytes()) / mb << " MB, índices "
+          << volumeIndex.sizeInBytes() / mb << " MB, espacio de trabajo " << workspace.residentBytes() / mb
+          << " MB, pico " << peakBufferBytes / mb << " MB." << '\n';
+    size_t resident = 0, peak = 0;
+    if (residentMemory(resident, peak))
+        out() << "  Memoria residente: " << resident / mb << " MB (pico " << peak / mb << " MB)." << '\n';
+    out().unsetf(ios::floatfield);
+    out() << setprecision(6);
+}
+
+/**
+ * @brief Muestra las estadísticas acumuladas desde el inicio o desde el último reinicio.
+ */
+bool ImageProcessingSystem::showStatistics(string param) {
+    double& seconds = currentSession ? currentSession->commandSeconds : commandSeconds;
+    if (param == "reiniciar") {
+        if (currentSession) resetProfile(currentSession->profile);
+        else resetProfile();
+        seconds = 0;
+        peakBufferBytes = bufferBytes();
+        out() << "Estadísticas reiniciadas." << '\n';
+        return true;
     }
-void ImageProcessingSystem::segmentImage(string param) {
-  cout << "No hay una imagen cargada en memoria." << endl;
+    if (!param.empty()) {
+        out() << "Uso incorrecto del comando. Escriba 'ayuda estadisticas' para más información." << '\n';
+        return false;
     }
-  
+
+    ProfileSnapshot zero = ProfileSnapshot();
+    out() << "Tiempo en comandos: " << fixed << setprecision(2) << seconds * 1000.0 << " ms." << '\n';
+    reportProfile(zero, commandProfile(), seconds);
+    return true;
+}
+
+/**
+ * @brief Activa o desactiva la traza por comando; sin parámetro muestra su estado.
+ */
+bool ImageProcessingSystem::setTrace(string param) {
+    bool& trace = currentSession ? currentSession->trace : traceCommands;
+    if (param == "si") trace = true;
+    else if (param == "no") trace = false;
+    else if (!param.empty()) {
+        out() << "Error: Use 'traza si' o 'traza no'." << '\n';
+        return false;
+    }
+    out() << "Traza por comando: " << (trace ? "activada" : "desactivada") << '\n';
+    return true;
+}
+
+/**
+ * @brief Guarda un PGM de salida: enseguida, o formateado aquí y entregado
+ * al hilo de escritura si la escritura diferida está activa.
+ */
+PgmStatus ImageProcessingSystem::savePGM(const string& filename, const PixelBuffer& image,
+                                         PgmFormat format, const string& comment) {
+    if (!deferredWrites) return writePGMFile(filename, image, format, comment);
+    vector<char> data;
+    PhaseTimer timer(Phase::FileWrite);
+    formatPGM(image, format, comment, data);
+    timer.stop();
+    writer.submit(filename, data);
+    return PgmStatus::Ok;
+}
+
+/**
+ * @brief Muestra los archivos diferidos que no se pudieron escribir; false si hubo alguno.
+ */
+bool ImageProcessingSystem::reportWriteErrors() {
+    vector<string> failed = writer.takeErrors();
+    for (size_t f = 0; f < failed.size(); ++f)
+        out() << "Error: No se pudo crear el archivo " << failed[f] << " (escritura diferida)" << '\n';
+    return failed.empty();
+}
+
+/**
+ * @brief Elige entre escritura inmediata y diferida de los PGM; sin parámetro muestra el modo.
+ */
+bool ImageProcessingSystem::setWriteMode(string param) {
+    if (param == "diferida") deferredWrites = true;
+    else if (param == "inmediata") deferredWrites = false;
+    else if (!param.empty()) {
+        out() << "Error: Use 'escritura diferida' o 'escritura inmediata'." << '\n';
+        return false;
+    }
+    if (!deferredWrites) writer.flush();
+    out() << "Escritura de archivos: " << (deferredWrites ? "diferida" : "inmediata") << '\n';
+    return true;
+}
@@ -9,43 +9,115 @@
 #include <algorithm>
 #include <numeric>
 #include <queue>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include "imagen.h"
+#include "pgm.h"
+#include "archivo_mapeado.h"
+#include "pool_hilos.h"
+#include "proyeccion.h"
+#include "huffman.h"
+#include "archivo_huf.h"
+#include "segmentacion.h"
+#include "lector_cortes.h"
+#include "cache_volumen.h"
+#include "perfil.h"
+#include "escritura_diferida.h"
+#include "indice_volumen.h"
+#include "volumen_comprimido.h"
+#include "espacio_trabajo.h"
+#include "servidor.h"
 using namespace std;
 
-struct HuffmanNode {
-    int symbol;             // Valor de intensidad (0..M) o -1 si es nodo interno
-    unsigned long freq;     // Frecuencia de aparición
-    HuffmanNode* left;      // Hijo izquierdo
-    HuffmanNode* right;     // Hijo derecho
-
-    HuffmanNode(int s, unsigned long f);
-};
-struct CompareNode {
-    bool operator()(HuffmanNode* a, HuffmanNode* b) const;
-};
 class ImageProcessingSystem {
 private:
+    // Cortes de un volumen abiertos con sus cabeceras (ver openVolumeFiles)
+    struct VolumeFiles {
+        vector<string> names;
+        vector<MappedFile> mapped;
+        vector<PgmHeader> headers;
+        int maxWidth, maxHeight, maxValue;
+        size_t bytes;
+    };
+
     //  Atributos privados
-    vector<vector<int>> imageData;
-    int width, height, maxPixelValue;
+    PixelBuffer imageData;          // Imagen cargada (buffer con depth == 1)
     string imageFilename;
     string volume;
-    vector<vector<vector<int>>> volumeData;
+    PixelBuffer volumeData;         // Cortes del volumen, todos con el tamaño máximo
+    VolumeIndex volumeIndex;        // Índices de volumeData (se descartan al cargar otro)
+    CompressedVolume compressedVolume;  // Volumen cargado con 'comprimido' (volumeData queda vacío)
+    Workspace workspace;            // Imágenes y volúmenes con nombre (ver 'espacio')
+    string imageSlot, volumeSlot;   // Nombres de la imagen y el volumen activos
+    ThreadPool pool;                // Hilos de trabajo reutilizados por los comandos
+    bool traceCommands = false;     // Desglose por fases después de cada comando (fuera del servidor)
+    double commandSeconds = 0;      // Tiempo en comandos para estadisticas (cada conexión tiene el suyo)
+    size_t peakBufferBytes = 0;     // Mayor tamaño visto de imagen + volumen + índices
+    mutex statsMutex;               // Protege peakBufferBytes entre comandos simultáneos
+    ReadWriteLock stateLock;        // Compartido para los comandos que solo leen (ver runsShared)
+    bool deferredWrites = false;    // Los PGM de salida se escriben desde writer
+    WriteBehind writer;
+
 
     //  Métodos privados
-    void loadImage(string filename);
-    void loadVolume(string param);
+    ostream& out() const;
+    int runScript(istream& script, bool stopOnError, bool flushEach);
+    bool runsShared(const string& command) const;
+    bool checkPgmStatus(const string& filename, PgmStatus status) const;
+    bool checkHufStatus(const string& filename, HufStatus status) const;
+    bool readPGM(const string& filename, PixelBuffer& image, size_t* bytesRead = nullptr);
+    bool parseOutputFormat(const string& name, PgmFormat& format) const;
+    bool takeOutputFormat(istream& args, PgmFormat& format) const;
+    void reportThroughput(size_t bytes, double seconds) const;
+    void reportProfile(const ProfileSnapshot& from, const ProfileSnapshot& to, double seconds) const;
+    string sliceFileName(const string& base, int index) const;
+    bool parseVolumeArgs(const string& baseName, const string& countText, int& count) const;
+    bool openVolumeFiles(const string& base, int count, VolumeFiles& files);
+    bool loadImage(string filename, const string& name = "");
+    bool loadVolume(string param, const string& name = "");
+    bool loadRawVolume(const string& base, int count);
+    bool loadCompressedVolume(const string& base, int count);
+    bool checkVolumeLoaded(bool needsRaw) const;
+    void parkImage();
+    void parkVolume();
+    bool selectImage(const string& name);
+    bool selectVolume(const string& name);
+    bool useSlot(string param);
+    bool showWorkspace(string param);
+    size_t activeBytes() const;
+    size_t bufferBytes() const;
     void infoImage();
     void infoVolume();
-    void projection2D(string param);
-    void encodeImage(string param);
-    void decodeFile(string param);
-    void segmentImage(string param);
-    void buildCodes(HuffmanNode* node,const string& prefix,vector<string>& codes) const;
-    void handleCommand(string command);
+    bool projection2D(string param);
+    bool projectionFused(ProjectionAxis axis, const string& criteriaList, const string& filename,
+                         PgmFormat format);
+    bool streamProjection(string param);
+    bool buildVolumeIndex(string param);
+    bool slabProjection(string param);
+    bool regionStatistics(string param);
+    bool encodeImage(string param);
+    bool decodeFile(string param);
+    bool encodeVolume(string param);
+    bool decodeVolume(string param);
+    bool segmentImage(string param);
+    bool segmentVolume(string param);
+    bool setThreads(string param);
+    bool showStatistics(string param);
+    bool setTrace(string param);
+    bool runCommand(string command);
+    PgmStatus savePGM(const string& filename, const PixelBuffer& image, PgmFormat format,
+                      const string& comment = "");
+    bool reportWriteErrors();
+    bool setWriteMode(string param);
+    bool handleCommand(string command);     // false si el comando falló
     void showHelp(string cmd);
 
 public:
-    void start();  // Único método público
+    void start();                                       // Modo interactivo
+    int runBatch(istream& script, bool stopOnError);    // Modo por lotes (ver sistema.cpp)
+    int serveSession(istream& input, ostream& output);  // Una conexión del servidor
 };
 
 #endif
@@ -0,0 +1,313 @@
+#include "volumen_comprimido.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "archivo_mapeado.h"
+#include "perfil.h"
+
+namespace {
+
+const unsigned char kMagic[4] = { 'H', 'U', 'F', 'V' };
+const unsigned kVersion = 1;
+const size_t kFixedHeader = 28;        // Hasta bytesModelo inclusive
+const size_t kIndexEntry = 16;         // desplazamiento + tamaño
+
+}  // namespace
+
+const size_t CompressedVolume::kDefaultCacheBytes;
+
+CompressedVolume::CompressedVolume()
+  : width_(0), height_(0), depth_(0), maxValue_(0),
+    budget_(kDefaultCacheBytes), cachedBytes_(0), hits_(0), misses_(0) {}
+
+void CompressedVolume::clear() {
+    std::vector<unsigned char>().swap(data_);
+    width_ = height_ = depth_ = maxValue_ = 0;
+    shared_.clear();
+    offsets_.clear();
+    sizes_.clear();
+    std::lock_guard<std::mutex> lock(mutex_);
+    cached_.clear();
+    recent_.clear();
+    cachedBytes_ = hits_ = misses_ = 0;
+}
+
+void CompressedVolume::swap(CompressedVolume& other) {
+    if (this == &other) return;
+    std::lock(mutex_, other.mutex_);
+    std::lock_guard<std::mutex> lock(mutex_, std::adopt_lock), otherLock(other.mutex_, std::adopt_lock);
+    data_.swap(other.data_);
+    std::swap(width_, other.width_);
+    std::swap(height_, other.height_);
+    std::swap(depth_, other.depth_);
+    std::swap(maxValue_, other.maxValue_);
+    shared_.swap(other.shared_);
+    offsets_.swap(other.offsets_);
+    sizes_.swap(other.sizes_);
+    cached_.swap(other.cached_);
+    recent_.swap(other.recent_);
+    std::swap(budget_, other.budget_);
+    std::swap(cachedBytes_, other.cachedBytes_);
+    std::swap(hits_, other.hits_);
+    std::swap(misses_, other.misses_);
+}
+
+size_t CompressedVolume::rawBytes() const {
+    return static_cast<size_t>(width_) * height_ * depth_ * (maxValue_ > 255 ? 2 : 1);
+}
+
+HufStatus CompressedVolume::encode(int width, int height, int depth, int maxValue, const SliceSource& source,
+                                   Predictor predictor, VolumeModel model, ThreadPool& pool) {
+    clear();
+    std::vector<std::vector<unsigned char> > streams(depth);
+    std::vector<unsigned char> failed(depth, 0);
+    std::mutex merge;
+
+    // 1. Modelo compartido: los símbolos de todos los cortes, con cada predictor candidato
+    HufModel sharedModel;
+    if (model == VolumeModel::Shared) {
+        const std::vector<Predictor> candidates = predictorCandidates(predictor);
+        std::vector<std::vector<unsigned long> > freq;
+        pool.parallelFor(0, depth, 1, [&](size_t begin, size_t end) {
+            PixelBuffer slice;
+            std::vector<std::vector<unsigned long> > local;
+            for (size_t k = begin; k < end; ++k) {
+                if (!source(static_cast<int>(k), slice)) failed[k] = 1;
+                else countHufSymbols(slice, candidates, pool, local);
+            }
+            std::lock_guard<std::mutex> lock(merge);
+            if (freq.empty()) freq.swap(local);
+            else
+                for (size_t p = 0; p < local.size(); ++p)
+                    for (size_t s = 0; s < local[p].size(); ++s) freq[p][s] += local[p][s];
+        });
+        for (int k = 0; k < depth; ++k)
+            if (failed[k]) return HufStatus::OpenError;
+        sharedModel = chooseHufModel(candidates, freq);
+    }
+
+    // 2. Un flujo .huf por corte, en paralelo
+    pool.parallelFor(0, depth, 1, [&](size_t begin, size_t end) {
+        PixelBuffer slice;
+        for (size_t k = begin; k < end; ++k) {
+            HufStatus status = HufStatus::OpenError;
+            if (source(static_cast<int>(k), slice)) {
+                status = model == VolumeModel::Shared ? encodeHufShared(slice, sharedModel, pool, streams[k])
+                                                      : encodeHuf(slice, pool, predictor, streams[k]);
+            }
+            failed[k] = status != HufStatus::Ok;
+        }
+    });
+    for (int k = 0; k < depth; ++k)
+        if (failed[k]) return HufStatus::OpenError;
+
+    // 3. Cabecera, índice y flujos
+    std::vector<unsigned char> modelBytes;
+    if (model == VolumeModel::Shared) putHufModel(modelBytes, sharedModel.lengths);
+    data_.assign(kMagic, kMagic + 4);
+    data_.push_back(static_cast<unsigned char>(kVersion));
+    data_.push_back(model == VolumeModel::Shared ? 1 : 0);
+    data_.push_back(0);
+    data_.push_back(0);
+    put32(data_, width);
+    put32(data_, height);
+    put32(data_, depth);
+    put32(data_, maxValue);
+    put32(data_, static_cast<uint32_t>(modelBytes.size()));
+    data_.insert(data_.end(), modelBytes.begin(), modelBytes.end());
+    uint64_t offset = data_.size() + depth * kIndexEntry + 4;
+    for (int k = 0; k < depth; ++k) {
+        put64(data_, offset);
+        put64(data_, streams[k].size());
+        offset += streams[k].size();
+    }
+    put32(data_, computeCrc32(data_.data(), data_.size()));
+    data_.reserve(offset);
+    for (int k = 0; k < depth; ++k) {
+        data_.insert(data_.end(), streams[k].begin(), streams[k].end());
+        std::vector<unsigned char>().swap(streams[k]);
+    }
+    return parse() ? HufStatus::Ok : HufStatus::Corrupt;
+}
+
+bool CompressedVolume::parse() {
+    const unsigned char* bytes = data_.data();
+    const size_t size = data_.size();
+    if (size < kFixedHeader || std::memcmp(bytes, kMagic, 4) != 0 || bytes[4] != kVersion || bytes[5] > 1)
+        return false;
+    const uint32_t width = get32(bytes + 8), height = get32(bytes + 12);
+    const uint32_t depth = get32(bytes + 16), maxValue = get32(bytes + 20);
+    const uint32_t modelSize = get32(bytes + 24);
+    if (width == 0 || height == 0 || depth == 0 || width > 0x7fffffff || height > 0x7fffffff ||
+        depth > 0x7fffffff || maxValue > 65535 || modelSize > size)
+        return false;
+    const size_t headerSize = kFixedHeader + modelSize + static_cast<size_t>(depth) * kIndexEntry + 4;
+    if (size < headerSize || computeCrc32(bytes, headerSize - 4) != get32(bytes + headerSize - 4))
+        return false;
+
+    std::vector<uint8_t> shared;
+    if (bytes[5] == 1 && !parseHufModel(bytes + kFixedHeader, modelSize, maxValue, shared)) return false;
+    if (bytes[5] == 0 && modelSize != 0) return false;
+
+    std::vector<uint64_t> offsets(depth), sizes(depth);
+    const unsigned char* index = bytes + kFixedHeader + modelSize;
+    for (uint32_t k = 0; k < depth; ++k) {
+        offsets[k] = get64(index + k * kIndexEntry);
+        sizes[k] = get64(index + k * kIndexEntry + 8);
+        if (offsets[k] < headerSize || offsets[k] > size || sizes[k] > size - offsets[k]) return false;
+    }
+
+    width_ = static_cast<int>(width);
+    height_ = static_cast<int>(height);
+    depth_ = static_cast<int>(depth);
+    maxValue_ = static_cast<int>(maxValue);
+    shared_.swap(shared);
+    offsets_.swap(offsets);
+    sizes_.swap(sizes);
+    std::lock_guard<std::mutex> lock(mutex_);
+    cached_.assign(depth_, std::shared_ptr<const PixelBuffer>());
+    recent_.clear();
+    cachedBytes_ = hits_ = misses_ = 0;
+    return true;
+}
+
+HufStatus CompressedVolume::load(const std::string& filename) {
+    clear();
+    MappedFile in;
+    if (!in.open(filename)) return HufStatus::OpenError;
+    recordBytesRead(in.size());
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(in.data());
+    data_.assign(bytes, bytes + in.size());
+    if (!parse()) {
+        clear();
+        return HufStatus::Corrupt;
+    }
+    return HufStatus::Ok;
+}
+
+HufStatus CompressedVolume::save(const std::string& filename) const {
+    // Escribir en un temporal y renombrar, como los PGM
+    PhaseTimer timer(Phase::FileWrite);
+    const std::string tmpName = temporaryName(filename);
+    std::ofstream file(tmpName, std::ios::binary);
+    if (!file) return HufStatus::WriteError;
+    file.write(reinterpret_cast<const char*>(data_.data()), data_.size());
+    file.close();
+    if (!file || std::rename(tmpName.c_str(), filename.c_str()) != 0) {
+        std::remove(tmpName.c_str());
+        return HufStatus::WriteError;
+    }
+    recordBytesWritten(data_.size());
+    return HufStatus::Ok;
+}
+
+HufStatus CompressedVolume::decodeSlice(int k, PixelBuffer& slice, ThreadPool& pool) const {
+    HufStatus status = decodeHuf(data_.data() + offsets_[k], sizes_[k], slice, pool, 0, -1,
+                                 shared_.empty() ? nullptr : &shared_);
+    if (status != HufStatus::Ok) return status;
+    // El flujo de cada corte debe coincidir con la cabecera del volumen
+    if (slice.width() != width_ || slice.height() != height_ || slice.maxValue() != maxValue_)
+        return HufStatus::Corrupt;
+    return HufStatus::Ok;
+}
+
+std::shared_ptr<const PixelBuffer> CompressedVolume::slice(int k, ThreadPool& pool) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cached_[k]) {
+            recent_.remove(k);
+            recent_.push_front(k);
+            ++hits_;
+            return cached_[k];
+        }
+        ++misses_;
+    }
+
+    // Se decodifica fuera del mutex; si otro hilo pidió el mismo corte, queda el primero
+    std::shared_ptr<PixelBuffer> decoded = std::make_shared<PixelBuffer>();
+    if (decodeSlice(k, *decoded, pool) != HufStatus::Ok) return std::shared_ptr<const PixelBuffer>();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!cached_[k]) {
+        cached_[k] = decoded;
+        cachedBytes_ += decoded->sizeInBytes();
+        recent_.push_front(k);
+        evict();
+    }
+    return cached_[k];
+}
+
+void CompressedVolume::evict() {
+    // Quien todavía usa un corte expulsado lo conserva por su shared_ptr
+    while (cachedBytes_ > budget_ && recent_.size() > 1) {
+        const int oldest = recent_.back();
+        recent_.pop_back();
+        cachedBytes_ -= cached_[oldest]->sizeInBytes();
+        cached_[oldest].reset();
+    }
+}
+
+void CompressedVolume::setCacheBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = bytes;
+    evict();
+}
+
+size_t CompressedVolume::cacheBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cachedBytes_;
+}
+
+void CompressedVolume::cacheCounters(size_t& hits, size_t& misses) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    hits = hits_;
+    misses = misses_;
+}
+
+HufStatus projectCompressedVolume(CompressedVolume& volume, ProjectionAxis axis,
+                                  ProjectionCriterion criterion, PixelBuffer& result, ThreadPool& pool) {
+    const int width = volume.width(), height = volume.height(), depth = volume.depth();
+
+    if (axis == ProjectionAxis::Z) {
+        StreamingZProjection projection(width, height, volume.maxValue(), depth, criterion);
+        for (int pass = 0; pass < projection.passes(); ++pass) {
+            for (int k = 0; k < depth; ++k) {
+                std::shared_ptr<const PixelBuffer> slice = volume.slice(k, pool);
+                if (!slice) return HufStatus::Corrupt;
+                PhaseTimer timer(Phase::Projection);
+                projection.add(*slice, pool);
+            }
+            projection.endPass();
+        }
+        PhaseTimer timer(Phase::Projection);
+        projection.finish(result, pool);
+        return HufStatus::Ok;
+    }
+
+    // y: el corte k da la fila k de la salida; x: la columna k
+    if (axis == ProjectionAxis::Y) result.allocate(width, depth, 1, volume.maxValue());
+    else result.allocate(depth, height, 1, volume.maxValue());
+    std::vector<unsigned char> failed(depth, 0);
+    pool.parallelFor(0, depth, 1, [&](size_t begin, size_t end) {
+        PixelBuffer line;
+        for (size_t k = begin; k < end; ++k) {
+            std::shared_ptr<const PixelBuffer> slice = volume.slice(static_cast<int>(k), pool);
+            if (!slice) {
+                failed[k] = 1;
+                continue;
+            }
+            PhaseTimer timer(Phase::Projection);
+            projectVolume(*slice, axis, criterion, line, pool);
+            const size_t bpp = result.bytesPerPixel();
+            if (axis == ProjectionAxis::Y) {
+                std::memcpy(result.data() + k * result.rowStride() * bpp, line.data(), width * bpp);
+            } else {
+                for (int i = 0; i < height; ++i) result.set(0, i, static_cast<int>(k), line.at(0, i, 0));
+            }
+        }
+    });
+    for (int k = 0; k < depth; ++k)
+        if (failed[k]) return HufStatus::Corrupt;
+    return HufStatus::Ok;
+}
@@ -0,0 +1,105 @@
+#ifndef VOLUMEN_COMPRIMIDO_H
+#define VOLUMEN_COMPRIMIDO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "archivo_huf.h"
+#include "imagen.h"
+#include "pool_hilos.h"
+#include "proyeccion.h"
+
+// ————————————
+// Volumen comprimido con Huffman, en archivo (.hufv) o en memoria.
+//
+// Cada corte es un flujo .huf completo (bloques de filas con su índice y
+// sus CRC-32), así que se decodifica solo y en paralelo por bloques. El
+// modelo puede ser uno compartido por todos los cortes, guardado una vez
+// en la cabecera, o uno por corte dentro de su flujo. Todos los enteros
+// van en little-endian:
+//
+//   "HUFV"  versión(u8)=1  compartido(u8)  reservado(u16)
+//   ancho(u32)  alto(u32)  cortes(u32)  M(u32)
+//   bytesModelo(u32)  modelo[bytesModelo]    (0 bytes si cada corte lleva el suyo)
+//   índice: cortes x { desplazamiento(u64)  tamaño(u64) }
+//   crcCabecera(u32)
+//   flujos de los cortes
+//
+// CompressedVolume guarda esos mismos bytes en memoria y entrega cortes
+// decodificados a pedido, con una caché LRU acotada en bytes: un volumen
+// cargado así ocupa lo que ocupa comprimido más la caché.
+//————————————
+enum class VolumeModel { Shared, PerSlice };
+
+class CompressedVolume {
+public:
+    // Deja en slice el corte k del volumen de origen (ancho x alto, valor
+    // máximo M); false si no se pudo. Se llama desde varios hilos a la vez.
+    typedef std::function<bool(int k, PixelBuffer& slice)> SliceSource;
+
+    static const size_t kDefaultCacheBytes = 64u << 20;
+
+    CompressedVolume();
+
+    void clear();
+    void swap(CompressedVolume& other);         // Intercambia datos y caché sin copiarlos
+    bool empty() const { return depth_ == 0; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int depth() const { return depth_; }
+    int maxValue() const { return maxValue_; }
+    bool sharedModel() const { return !shared_.empty(); }
+    size_t compressedBytes() const { return data_.size(); }
+    size_t rawBytes() const;                    // Lo que ocuparía descomprimido
+
+    // Codifica los depth cortes de source en paralelo. Con modelo
+    // compartido source se recorre dos veces: para contar y para codificar.
+    HufStatus encode(int width, int height, int depth, int maxValue, const SliceSource& source,
+                     Predictor predictor, VolumeModel model, ThreadPool& pool);
+
+    HufStatus load(const std::string& filename);
+    HufStatus save(const std::string& filename) const;
+
+    // Decodifica el corte k en slice, sin pasar por la caché.
+    HufStatus decodeSlice(int k, PixelBuffer& slice, ThreadPool& pool) const;
+
+    // Corte k desde la caché, decodificándolo si no está; nullptr si sus
+    // datos están dañados. Se puede llamar desde varios hilos.
+    std::shared_ptr<const PixelBuffer> slice(int k, ThreadPool& pool);
+
+    void setCacheBudget(size_t bytes);
+    size_t cacheBytes() const;
+    void cacheCounters(size_t& hits, size_t& misses) const;
+
+private:
+    CompressedVolume(const CompressedVolume&);              // No copiable
+    CompressedVolume& operator=(const CompressedVolume&);
+
+    bool parse();                               // Valida data_ y llena los campos
+    void evict();                               // Con mutex_ tomado
+
+    std::vector<unsigned char> data_;
+    int width_, height_, depth_, maxValue_;
+    std::vector<uint8_t> shared_;               // Modelo compartido (vacío si es por corte)
+    std::vector<uint64_t> offsets_, sizes_;     // Flujo de cada corte dentro de data_
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<const PixelBuffer> > cached_;
+    std::list<int> recent_;                     // Cortes en caché, el más reciente adelante
+    size_t budget_, cachedBytes_, hits_, misses_;
+};
+
+// Proyección de un volumen comprimido, idéntica a la de projectVolume sobre
+// el volumen descomprimido. Para x e y cada corte da una columna o una fila
+// de la salida, y los cortes se reparten entre los hilos; para z los cortes
+// se acumulan de a uno con StreamingZProjection. En ningún momento hay más
+// cortes decodificados que los de la caché y los que se están procesando.
+HufStatus projectCompressedVolume(CompressedVolume& volume, ProjectionAxis axis,
+                                  ProjectionCriterion criterion, PixelBuffer& result, ThreadPool& pool);
+
+#endif